@@ -5,31 +5,78 @@
                 (Maps, Sets, Lists, Stacks and Queues), with Iterators and Algorithms.
     Details:    Added Achievement System, NPC Character Traits, Narrative Dealer Characteristics
                 Color Coded UI, Betting System, and Persistent Profiles
-    Compile:    g++ -std=c++17 blackjack.cpp -o blackjack
+    Compile:    g++ -std=c++20 -pthread main.cpp -o blackjack
+    Run:        ./blackjack [--audit] [--simulate ROUNDS] [--precision PCT [--confidence 90|95|99]]
+                            [--threads N] [--seats N] [--histograms] [--checkpoint FILE [--checkpoint-every SECS]]
+                            [--resume FILE] [--history DIR] [--events DIR] [--seed N]
+                    --precision stops early once every seat is within PCT, and otherwise at ROUNDS
+                    (100000000 when --simulate isn't given)
+                ./blackjack --replay EVENTLOG [--round N]
+                ./blackjack --bot [--audit] [--seed N] [--history DIR] [--events DIR]
+                    JSON lines on stdout (bet/turn/result/deal/over), one reply per line on stdin
+                ./blackjack --serve SOCKET|:PORT [--tables N] [--threads N] [--turn-timeout SECS] [--audit] [--seed N]
+                    clients send "JOIN <name>", then play with the same keys as the terminal game,
+                    or "BOT <name>" to get the --bot protocol instead
+                ./blackjack --loadgen SOCKET|:PORT [--clients N] [--rounds N] [--duration SECS] [--think MS]
+                            [--policy stand|hit17|random] [--seed N]
+                    bot clients against a running server (which needs --tables >= clients);
+                    reports rounds/s, latency percentiles and errors, and exits 1 if there were errors
+                ./blackjack [--threads N] --query DIR|FILE [column=value|column=lo..hi ...]
+                    columns: seat personality start upcard ncards decisions final outcome
 */
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bitset>
+#include <charconv>
 #include <chrono>
+#include <condition_variable>
+#include <coroutine>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
 #include <deque>
+#include <cstdint>
 #include <exception>
+#include <filesystem>
 #include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <queue>
 #include <random>
 #include <set>
 #include <stack>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <stdexcept>
 #include <thread>
 #include <utility>
+#include <vector>
 #include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 // -----------------------------
 // ANSI COLOR MACROS
@@ -57,9 +104,13 @@
 // Utility sleep wrapper
 // -----------------------------
 void sleep_ms(int ms) {
+    if (ms <= 0) return;
     std::this_thread::sleep_for(std::chrono::milliseconds(ms));
 }
 
+// Chip amounts, round numbers and lifetime counters are 64-bit; a billion-round run overflows int
+using Chips = std::int64_t;
+
 // -----------------------------
 // Card, Deck
 // -----------------------------
@@ -87,6 +138,18 @@ struct Card {
         return oss.str();
     }
     std::string canonical() const { return rank + "-" + std::to_string(static_cast<int>(suit)); }
+    // One byte per card for binary records: rank index * 4 + suit
+    std::uint8_t to_byte() const {
+        int r = static_cast<int>(std::find(RankNames.begin(), RankNames.end(), rank) - RankNames.begin());
+        return static_cast<std::uint8_t>(r * 4 + static_cast<int>(suit));
+    }
+    // Hi-lo count tag: 2-6 = +1, 7-9 = 0, tens and aces = -1
+    int hilo() const {
+        char c = rank[0];
+        if (c >= '2' && c <= '6') return 1;
+        if (c >= '7' && c <= '9') return 0;
+        return -1;
+    }
 };
 
 int compute_hand_value(const std::list<Card>& hand) {
@@ -119,25 +182,129 @@ bool is_soft_hand(const std::list<Card>& hand) {
     return (aces > 0) && (total <= 21);
 }
 
+// -----------------------------
+// Streaming statistics (Welford) and bounded wager history
+// -----------------------------
+struct RunningStats {
+    std::uint64_t count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;        // sum of squared deviations from the mean
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+
+    void add(double x) {
+        if (count == 0) { min = max = x; }
+        else { min = std::min(min, x); max = std::max(max, x); }
+        ++count;
+        sum += x;
+        double delta = x - mean;
+        mean += delta / static_cast<double>(count);
+        m2 += delta * (x - mean);
+    }
+    // Combine two accumulators (Chan et al.), e.g. per-thread shards into one report
+    void merge(const RunningStats& o) {
+        if (o.count == 0) return;
+        if (count == 0) { *this = o; return; }
+        double n = static_cast<double>(count + o.count);
+        double delta = o.mean - mean;
+        mean += delta * static_cast<double>(o.count) / n;
+        m2 += o.m2 + delta * delta * static_cast<double>(count) * static_cast<double>(o.count) / n;
+        count += o.count;
+        sum += o.sum;
+        min = std::min(min, o.min);
+        max = std::max(max, o.max);
+    }
+    double variance() const { return count > 1 ? m2 / static_cast<double>(count - 1) : 0.0; }
+    double stddev() const { return std::sqrt(variance()); }
+    // Half-width of the normal-approximation confidence interval for the mean
+    double ci(double z) const { return count > 1 ? z * stddev() / std::sqrt(static_cast<double>(count)) : 0.0; }
+    double ci95() const { return ci(1.96); }
+};
+
+// Last kWindow wagers in a ring plus aggregates over every wager ever placed
+struct WagerHistory {
+    static const std::size_t kWindow = 16;
+    std::array<Chips,kWindow> recent{};
+    RunningStats all;
+
+    void push_back(Chips bet) { recent[all.count % kWindow] = bet; all.add(static_cast<double>(bet)); }
+    void clear() { all = RunningStats{}; }
+    bool empty() const { return all.count == 0; }
+    std::size_t recent_size() const { return static_cast<std::size_t>(std::min<std::uint64_t>(all.count, kWindow)); }
+    // i = 0 is the oldest wager in the window
+    Chips recent_at(std::size_t i) const { return recent[(all.count - recent_size() + i) % kWindow]; }
+    Chips last() const { return empty() ? 0 : recent[(all.count - 1) % kWindow]; }
+};
+
+// Win rate, bust rate and net chips over the last N rounds. Each round pushes one sample
+// and subtracts the one it evicts from the running sums, so an update is O(1) for any N.
+struct RollingWindow {
+    struct Sample { Chips net = 0; bool won = false; bool busted = false; };
+    std::vector<Sample> ring;
+    std::size_t next = 0;
+    std::size_t filled = 0;
+    std::int64_t wins = 0;
+    std::int64_t busts = 0;
+    Chips net = 0;
+
+    explicit RollingWindow(std::size_t n = 100) : ring(n) {}
+    void push(bool won, bool busted, Chips delta) {
+        Sample &old = ring[next];
+        if (filled == ring.size()) { wins -= old.won; busts -= old.busted; net -= old.net; }
+        else ++filled;
+        old = Sample{delta, won, busted};
+        wins += won; busts += busted; net += delta;
+        next = (next + 1) % ring.size();
+    }
+    void clear() { *this = RollingWindow(ring.size()); }
+    std::size_t capacity() const { return ring.size(); }
+    double win_rate() const { return filled ? static_cast<double>(wins) / static_cast<double>(filled) : 0.0; }
+    double bust_rate() const { return filled ? static_cast<double>(busts) / static_cast<double>(filled) : 0.0; }
+};
+
+// Per-seat short and long windows shown on the scoreboard and in the profiles menu
+static const std::array<std::size_t,2> kRollingWindowSizes = {100, 1000};
+struct SeatWindows {
+    std::array<RollingWindow,2> w{RollingWindow(kRollingWindowSizes[0]), RollingWindow(kRollingWindowSizes[1])};
+    void push(bool won, bool busted, Chips delta) { for (auto &x : w) x.push(won, busted, delta); }
+    void clear() { for (auto &x : w) x.clear(); }
+};
+
 // -----------------------------
 // Player & Stats
 // -----------------------------
+enum class Personality : int { Human = 0, Cautious, Reckless, Smart, Chaotic, Default, Count };
+static const int kPersonalityCount = static_cast<int>(Personality::Count);
+static const std::array<std::string,kPersonalityCount> PersonalityNames = {"Human","Cautious","Reckless","Smart","Chaotic","Default"};
+
+static Personality personality_from_name(const std::string& name, bool human) {
+    if (human) return Personality::Human;
+    if (name.find("Cautious") != std::string::npos) return Personality::Cautious;
+    if (name.find("Reckless") != std::string::npos) return Personality::Reckless;
+    if (name.find("Smart") != std::string::npos) return Personality::Smart;
+    if (name.find("Chaotic") != std::string::npos) return Personality::Chaotic;
+    return Personality::Default;
+}
+
 struct Player {
     std::string name;
+    int seat = -1;          // table position, assigned once in init_players
+    int id = -1;            // interned profile id
     bool is_human = false;
-    int chips = 100;
+    Personality personality = Personality::Default;
     std::list<Card> hand;
     bool active = true;
     bool stood = false;
     bool busted = false;
-    std::list<int> wager_history;
-    int last_bet = 0;
+    WagerHistory wager_history;
+    Chips last_bet = 0;
 
     // Dialogue queue: speech lines unique per NPC (deque)
     std::deque<std::string> speech;
 
     Player() = default;
-    Player(const std::string& n, bool human, int starting_chips): name(n), is_human(human), chips(starting_chips), hand(), active(true), stood(false), busted(false), wager_history(), last_bet(0) {}
+    Player(const std::string& n, bool human): name(n), is_human(human), personality(personality_from_name(n, human)), hand(), active(true), stood(false), busted(false), wager_history(), last_bet(0) {}
     void clear_hand() { hand.clear(); active = true; stood = false; busted = false; }
     void receive_card(const Card& c) { hand.push_back(c); }
     std::string hand_to_string() const {
@@ -164,34 +331,204 @@ struct Player {
 };
 
 struct PlayerStats {
-    int wins = 0;
-    int losses = 0;
-    int ties = 0;
-    int best_streak = 0;
-    int current_streak = 0;
-    int biggest_win = 0;
-    int total_games = 0;
-    int blackjacks = 0;
+    std::int64_t wins = 0;
+    std::int64_t losses = 0;
+    std::int64_t ties = 0;
+    std::int64_t best_streak = 0;
+    std::int64_t current_streak = 0;
+    Chips biggest_win = 0;
+    std::int64_t total_games = 0;
+    std::int64_t blackjacks = 0;
     std::set<std::string> achievements;
 };
 
+// Net chips per round and net per chip wagered, for one seat or one personality
+struct EvStats {
+    RunningStats net;
+    RunningStats per_unit;
+    void add(Chips bet, Chips payout) {
+        net.add(static_cast<double>(payout - bet));
+        if (bet > 0) per_unit.add(static_cast<double>(payout - bet) / static_cast<double>(bet));
+    }
+    void merge(const EvStats& o) { net.merge(o.net); per_unit.merge(o.per_unit); }
+};
+
+// Fixed-bucket counter; out-of-range samples land in the first or last bucket
+template <int N>
+struct Histogram {
+    std::array<std::uint64_t,N> buckets{};
+    void add(std::int64_t bucket) { ++buckets[std::max<std::int64_t>(0, std::min<std::int64_t>(N - 1, bucket))]; }
+    void merge(const Histogram& o) { for (int i = 0; i < N; ++i) buckets[i] += o.buckets[i]; }
+    std::uint64_t total() const { return std::accumulate(buckets.begin(), buckets.end(), std::uint64_t(0)); }
+};
+
+// Payouts bucket by bit length: 0 = no payout, k = [2^(k-1), 2^k); the histogram's last bucket
+// also takes everything above it
+static int payout_bucket(Chips payout) {
+    int b = 0;
+    for (std::uint64_t v = payout > 0 ? static_cast<std::uint64_t>(payout) : 0u; v; v >>= 1) ++b;
+    return b;
+}
+
+struct OutcomeHistograms {
+    Histogram<32> hand;     // final hand value, 31 = 31 or more
+    Histogram<10> bust;     // busted value 22..31, bucket = value - 22
+    Histogram<16> payout;   // see payout_bucket; 15 = 16384 or more
+    Histogram<32> streak;   // length of each finished win streak, 31 = 31 or more
+
+    void merge(const OutcomeHistograms& o) { hand.merge(o.hand); bust.merge(o.bust); payout.merge(o.payout); streak.merge(o.streak); }
+};
+
+// One table's (or one thread's) statistics; shards merge into a combined report
+struct StatsShard {
+    std::vector<EvStats> seats;                          // indexed by seat id
+    std::array<EvStats,kPersonalityCount> personalities;
+    std::vector<OutcomeHistograms> seat_hists;           // indexed by seat id
+    std::array<OutcomeHistograms,kPersonalityCount> personality_hists;
+
+    void resize(std::size_t n) { seats.resize(n); seat_hists.resize(n); }
+    void merge(const StatsShard& o) {
+        if (seats.size() < o.seats.size()) resize(o.seats.size());
+        for (std::size_t i = 0; i < o.seats.size(); ++i) { seats[i].merge(o.seats[i]); seat_hists[i].merge(o.seat_hists[i]); }
+        for (int i = 0; i < kPersonalityCount; ++i) { personalities[i].merge(o.personalities[i]); personality_hists[i].merge(o.personality_hists[i]); }
+    }
+};
+
+// Prints the non-empty buckets of one histogram as "label: bucket=count(pct%) ..."
+template <int N, typename Name>
+static void dump_histogram(std::ostream& os, const char* label, const Histogram<N>& h, Name bucket_name) {
+    std::uint64_t total = h.total();
+    os << "  " << std::left << std::setw(7) << label << std::right;
+    if (total == 0) { os << " (empty)\n"; return; }
+    os << std::fixed << std::setprecision(1);
+    for (int i = 0; i < N; ++i) {
+        if (!h.buckets[i]) continue;
+        os << " " << bucket_name(i) << "=" << h.buckets[i] << "(" << 100.0 * h.buckets[i] / total << "%)";
+    }
+    os << std::defaultfloat << "\n";
+}
+
+static void dump_outcome_histograms(std::ostream& os, const std::string& title, const OutcomeHistograms& h) {
+    os << title << "\n";
+    dump_histogram(os, "hand", h.hand, [](int i) { return i == 31 ? std::string("31+") : std::to_string(i); });
+    dump_histogram(os, "bust", h.bust, [](int i) { return std::to_string(i + 22); });
+    dump_histogram(os, "payout", h.payout, [&h](int i) {
+        if (i == 0) return std::string("0");
+        if (i == static_cast<int>(h.payout.buckets.size()) - 1) return std::to_string(std::uint64_t(1) << (i - 1)) + "+";
+        return "<" + std::to_string(std::uint64_t(1) << i);
+    });
+    dump_histogram(os, "streak", h.streak, [](int i) { return i == 31 ? std::string("31+") : std::to_string(i); });
+}
+
 // -----------------------------
-// Achievements definitions
+// Seat bitset: fixed-size set of seat ids with set-bit iteration
 // -----------------------------
-static const std::map<std::string,std::string> all_achievements = {
-    {"BLACKJACK","Natural Blackjack: get a 2-card 21."},
-    {"HIGH_ROLLER","Win a round with a payout of 40+ chips."},
-    {"HOT_STREAK","Win 3 rounds in a row."},
-    {"CARD_SHARK","Win 10 total rounds."},
-    {"SURVIVOR","Reach 200 chips."},
-    {"UNSTOPPABLE","Reach 300 chips."},
-    {"IT_HAPPENS","Bust badly (22+)."},
-    {"CLOSE_CALL","Stand on 20 and still lose."},
-    {"AGAINST_ODDS","Beat an opponent who had 20 or 21."},
-    {"MARATHONER","Play 20 rounds."},
-    {"GAMBLER_SPIRIT","Play 50 rounds."}
+static const int kMaxSeats = 128;
+
+struct SeatSet {
+    std::array<std::uint64_t, kMaxSeats / 64> words{};
+
+    void set(int seat) { words[seat >> 6] |= (std::uint64_t(1) << (seat & 63)); }
+    bool test(int seat) const { return (words[seat >> 6] >> (seat & 63)) & 1; }
+    void clear() { words.fill(0); }
+    bool empty() const { for (auto w : words) if (w) return false; return true; }
+    int count() const { int n = 0; for (auto w : words) n += __builtin_popcountll(w); return n; }
+    // Calls f(seat) for each member in ascending seat order
+    template <typename F>
+    void for_each(F&& f) const {
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            for (std::uint64_t w = words[i]; w; w &= w - 1)
+                f(static_cast<int>(i * 64 + __builtin_ctzll(w)));
+        }
+    }
 };
 
+// -----------------------------
+// Checkpoint serialization: whitespace-separated text. Callers set precision 17 so doubles
+// round-trip exactly and a resumed accumulator continues bit-identically.
+// -----------------------------
+static void write_state(std::ostream& os, const RunningStats& s) {
+    os << s.count << ' ' << s.mean << ' ' << s.m2 << ' ' << s.sum << ' ' << s.min << ' ' << s.max << '\n';
+}
+static void read_state(std::istream& is, RunningStats& s) { is >> s.count >> s.mean >> s.m2 >> s.sum >> s.min >> s.max; }
+
+template <int N>
+static void write_state(std::ostream& os, const Histogram<N>& h) {
+    for (auto b : h.buckets) os << b << ' ';
+    os << '\n';
+}
+template <int N>
+static void read_state(std::istream& is, Histogram<N>& h) { for (auto &b : h.buckets) is >> b; }
+
+static void write_state(std::ostream& os, const OutcomeHistograms& h) {
+    write_state(os, h.hand); write_state(os, h.bust); write_state(os, h.payout); write_state(os, h.streak);
+}
+static void read_state(std::istream& is, OutcomeHistograms& h) {
+    read_state(is, h.hand); read_state(is, h.bust); read_state(is, h.payout); read_state(is, h.streak);
+}
+
+static void write_state(std::ostream& os, const StatsShard& s) {
+    os << s.seats.size() << '\n';
+    for (std::size_t i = 0; i < s.seats.size(); ++i) {
+        write_state(os, s.seats[i].net); write_state(os, s.seats[i].per_unit); write_state(os, s.seat_hists[i]);
+    }
+    for (int i = 0; i < kPersonalityCount; ++i) {
+        write_state(os, s.personalities[i].net); write_state(os, s.personalities[i].per_unit); write_state(os, s.personality_hists[i]);
+    }
+}
+static void read_state(std::istream& is, StatsShard& s) {
+    std::size_t n = 0;
+    if (!(is >> n) || n > static_cast<std::size_t>(kMaxSeats)) { is.setstate(std::ios::failbit); return; }
+    s = StatsShard{};
+    s.resize(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        read_state(is, s.seats[i].net); read_state(is, s.seats[i].per_unit); read_state(is, s.seat_hists[i]);
+    }
+    for (int i = 0; i < kPersonalityCount; ++i) {
+        read_state(is, s.personalities[i].net); read_state(is, s.personalities[i].per_unit); read_state(is, s.personality_hists[i]);
+    }
+}
+
+// A rolling window saves its samples oldest first and is rebuilt by pushing them again
+static void write_state(std::ostream& os, const RollingWindow& w) {
+    os << w.filled;
+    for (std::size_t i = 0; i < w.filled; ++i) {
+        const RollingWindow::Sample &x = w.ring[(w.next + w.ring.size() - w.filled + i) % w.ring.size()];
+        os << ' ' << x.net << ' ' << x.won << ' ' << x.busted;
+    }
+    os << '\n';
+}
+static void read_state(std::istream& is, RollingWindow& w) {
+    std::size_t n = 0;
+    w.clear();
+    if (!(is >> n) || n > w.capacity()) { is.setstate(std::ios::failbit); return; }
+    for (std::size_t i = 0; i < n && is; ++i) {
+        RollingWindow::Sample x;
+        is >> x.net >> x.won >> x.busted;
+        w.push(x.won, x.busted, x.net);
+    }
+}
+
+// -----------------------------
+// Achievements definitions
+// Built-in set, in the same "KEY | event | condition | description" format that
+// operators use in achievements.cfg. A cfg entry with an existing key replaces it.
+// -----------------------------
+static const char* kBuiltinAchievements = R"(
+BLACKJACK      | blackjack | true                      | Natural Blackjack: get a 2-card 21.
+HIGH_ROLLER    | payout    | payout >= 40              | Win a round with a payout of 40+ chips.
+HOT_STREAK     | round_end | won && streak >= 3        | Win 3 rounds in a row.
+CARD_SHARK     | round_end | won && wins >= 10         | Win 10 total rounds.
+SURVIVOR       | round_end | won && chips >= 200       | Reach 200 chips.
+UNSTOPPABLE    | round_end | won && chips >= 300       | Reach 300 chips.
+IT_HAPPENS     | bust      | hand >= 22                | Bust badly (22+).
+CLOSE_CALL     | round_end | !won && stood && hand == 20 | Stand on 20 and still lose.
+AGAINST_ODDS   | round_end | won && opp_best >= 20     | Beat an opponent who had 20 or 21.
+MARATHONER     | round_end | games >= 20               | Play 20 rounds.
+GAMBLER_SPIRIT | round_end | games >= 50               | Play 50 rounds.
+)";
+static const char* kAchievementsConfigFile = "achievements.cfg";
+
 static std::string join_achievements(const std::set<std::string>& s) {
     std::ostringstream oss;
     bool first = true;
@@ -210,6 +547,531 @@ static std::set<std::string> split_achievements(const std::string& s) {
     return res;
 }
 
+// -----------------------------
+// Achievement engine (event driven)
+// Each rule subscribes to one event type and is only evaluated when that event fires.
+// Per-seat unlock state is a bitset, so "already unlocked" is an O(1) test.
+// -----------------------------
+enum class GameEvent : int { Payout = 0, Bust, Stand, Blackjack, RoundEnd, Count };
+static const int kEventCount = static_cast<int>(GameEvent::Count);
+static const int kMaxAchievements = 128;
+static const std::array<std::string,kEventCount> EventNames = {"payout","bust","stand","blackjack","round_end"};
+
+// Values a condition may reference; names are resolved to these indices at compile time
+enum class Field : int { Payout = 0, Hand, Chips, Streak, Wins, Games, OppBest, Won, Stood, Count };
+static const int kFieldCount = static_cast<int>(Field::Count);
+static const std::array<std::string,kFieldCount> FieldNames = {"payout","hand","chips","streak","wins","games","opp_best","won","stood"};
+
+// Everything a rule may look at, filled in O(1) by the game when the event fires
+struct EventContext {
+    GameEvent type = GameEvent::RoundEnd;
+    int seat = 0;
+    std::array<std::int64_t,kFieldCount> values{};
+    std::int64_t& operator[](Field f) { return values[static_cast<int>(f)]; }
+    std::int64_t operator[](Field f) const { return values[static_cast<int>(f)]; }
+};
+
+// -----------------------------
+// Predicate bytecode: conditions compile to a postfix program over a small int stack
+// -----------------------------
+enum class Op : std::uint8_t { Field, Const, Eq, Ne, Lt, Le, Gt, Ge, And, Or, Not };
+struct Instr { Op op; int arg; };
+
+static const int kMaxPredicateDepth = 16;
+
+struct PredicateProgram {
+    std::vector<Instr> code;
+
+    bool eval(const EventContext& ev) const {
+        std::int64_t stack[kMaxPredicateDepth];
+        int sp = 0;
+        for (const Instr &in : code) {
+            switch (in.op) {
+                case Op::Field: stack[sp++] = ev.values[in.arg]; break;
+                case Op::Const: stack[sp++] = in.arg; break;
+                case Op::Not:   stack[sp-1] = !stack[sp-1]; break;
+                default: {
+                    std::int64_t b = stack[--sp], a = stack[sp-1], r = 0;
+                    switch (in.op) {
+                        case Op::Eq: r = a == b; break;
+                        case Op::Ne: r = a != b; break;
+                        case Op::Lt: r = a < b; break;
+                        case Op::Le: r = a <= b; break;
+                        case Op::Gt: r = a > b; break;
+                        case Op::Ge: r = a >= b; break;
+                        case Op::And: r = a && b; break;
+                        case Op::Or: r = a || b; break;
+                        default: break;
+                    }
+                    stack[sp-1] = r;
+                }
+            }
+        }
+        return sp > 0 && stack[sp-1] != 0;
+    }
+};
+
+// Recursive-descent compiler for: or := and ('||' and)* ; and := unary ('&&' unary)* ;
+// unary := '!' unary | cmp ; cmp := atom (op atom)? ; atom := field | int | true | false | '(' or ')'
+class PredicateCompiler {
+private:
+    const std::string& src;
+    std::size_t pos = 0;
+    int depth = 0, max_depth = 0;
+    std::vector<Instr> code;
+
+    void skip_ws() { while (pos < src.size() && std::isspace((unsigned char)src[pos])) ++pos; }
+    bool accept(const char* tok) {
+        skip_ws();
+        std::size_t n = std::char_traits<char>::length(tok);
+        if (src.compare(pos, n, tok) != 0) return false;
+        pos += n;
+        return true;
+    }
+    void emit(Op op, int arg = 0) {
+        code.push_back(Instr{op, arg});
+        if (op == Op::Field || op == Op::Const) max_depth = std::max(max_depth, ++depth);
+        else if (op != Op::Not) --depth;
+    }
+    void parse_atom() {
+        skip_ws();
+        if (accept("(")) {
+            parse_or();
+            if (!accept(")")) throw std::runtime_error("expected ')'");
+            return;
+        }
+        if (pos < src.size() && (std::isdigit((unsigned char)src[pos]) || src[pos] == '-')) {
+            std::size_t used = 0;
+            int v = std::stoi(src.substr(pos), &used);
+            pos += used;
+            emit(Op::Const, v);
+            return;
+        }
+        std::size_t start = pos;
+        while (pos < src.size() && (std::isalnum((unsigned char)src[pos]) || src[pos] == '_')) ++pos;
+        std::string word = src.substr(start, pos - start);
+        if (word == "true") { emit(Op::Const, 1); return; }
+        if (word == "false") { emit(Op::Const, 0); return; }
+        for (int f = 0; f < kFieldCount; ++f) if (FieldNames[f] == word) { emit(Op::Field, f); return; }
+        throw std::runtime_error(word.empty() ? "expected a value" : "unknown field '" + word + "'");
+    }
+    void parse_cmp() {
+        parse_atom();
+        static const std::array<std::pair<const char*,Op>,6> ops = {{
+            {"==",Op::Eq},{"!=",Op::Ne},{"<=",Op::Le},{">=",Op::Ge},{"<",Op::Lt},{">",Op::Gt}
+        }};
+        for (auto &o : ops) if (accept(o.first)) { parse_atom(); emit(o.second); return; }
+    }
+    void parse_unary() {
+        if (accept("!")) { parse_unary(); emit(Op::Not); return; }
+        parse_cmp();
+    }
+    void parse_and() {
+        parse_unary();
+        while (accept("&&")) { parse_unary(); emit(Op::And); }
+    }
+    void parse_or() {
+        parse_and();
+        while (accept("||")) { parse_and(); emit(Op::Or); }
+    }
+
+public:
+    explicit PredicateCompiler(const std::string& s) : src(s) {}
+    PredicateProgram compile() {
+        parse_or();
+        skip_ws();
+        if (pos != src.size()) throw std::runtime_error("unexpected '" + src.substr(pos) + "'");
+        if (max_depth > kMaxPredicateDepth) throw std::runtime_error("condition nests too deeply");
+        return PredicateProgram{code};
+    }
+};
+
+struct AchievementRule {
+    std::string key;
+    std::string description;
+    GameEvent on;
+    PredicateProgram pred;
+};
+
+class AchievementEngine {
+private:
+    std::vector<AchievementRule> rules;
+    std::array<std::vector<int>, kEventCount> subscribers;
+    std::vector<std::bitset<kMaxAchievements>> unlocked;   // indexed by seat id
+
+    static std::string trim(const std::string& s) {
+        std::size_t b = s.find_first_not_of(" \t\r"), e = s.find_last_not_of(" \t\r");
+        return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+    }
+
+public:
+    // Adds or replaces a rule; returns false once the rule table is full
+    bool add_rule(AchievementRule rule) {
+        for (auto &r : rules) if (r.key == rule.key) { r = std::move(rule); rebuild_subscriptions(); return true; }
+        if ((int)rules.size() >= kMaxAchievements) return false;
+        subscribers[static_cast<int>(rule.on)].push_back((int)rules.size());
+        rules.push_back(std::move(rule));
+        return true;
+    }
+    void rebuild_subscriptions() {
+        for (auto &s : subscribers) s.clear();
+        for (std::size_t i = 0; i < rules.size(); ++i) subscribers[static_cast<int>(rules[i].on)].push_back((int)i);
+    }
+
+    // Parse "KEY | event | condition | description" lines; bad lines are reported and skipped
+    int load_definitions(std::istream& in, const std::string& source) {
+        int loaded = 0, line_no = 0;
+        std::string line;
+        while (std::getline(in, line)) {
+            ++line_no;
+            std::string t = trim(line);
+            if (t.empty() || t[0] == '#') continue;
+            std::array<std::string,4> parts;
+            std::istringstream iss(t);
+            int n = 0;
+            while (n < 3 && std::getline(iss, parts[n], '|')) ++n;
+            if (n == 3) std::getline(iss, parts[3]);
+            for (auto &p : parts) p = trim(p);
+            try {
+                if (n < 3 || parts[0].empty()) throw std::runtime_error("expected KEY | event | condition | description");
+                int ev = -1;
+                for (int e = 0; e < kEventCount; ++e) if (EventNames[e] == parts[1]) ev = e;
+                if (ev < 0) throw std::runtime_error("unknown event '" + parts[1] + "'");
+                AchievementRule rule{parts[0], parts[3], static_cast<GameEvent>(ev), PredicateCompiler(parts[2]).compile()};
+                if (!add_rule(std::move(rule))) throw std::runtime_error("too many achievements");
+                ++loaded;
+            } catch (const std::exception &ex) {
+                std::cerr << "Warning: " << source << ":" << line_no << ": " << ex.what() << "\n";
+            }
+        }
+        return loaded;
+    }
+
+    void resize_seats(int seats) { unlocked.assign(seats, std::bitset<kMaxAchievements>()); }
+    void reset_seat(int seat) { if (seat >= 0 && seat < (int)unlocked.size()) unlocked[seat].reset(); }
+    // Mark rules already held by a profile so they never fire again for that seat
+    void mark_unlocked(int seat, const std::set<std::string>& keys) {
+        if (seat < 0 || seat >= (int)unlocked.size()) return;
+        for (std::size_t i = 0; i < rules.size(); ++i)
+            if (keys.count(rules[i].key)) unlocked[seat].set(i);
+    }
+    const std::vector<AchievementRule>& all() const { return rules; }
+    const AchievementRule& rule(int r) const { return rules[r]; }
+    std::string description_of(const std::string& key) const {
+        for (auto &r : rules) if (r.key == key) return r.description;
+        return "";
+    }
+
+    // Evaluate only the rules subscribed to ev.type; on_unlock(seat, rule) fires once per seat and rule
+    template <typename F>
+    void dispatch(const EventContext& ev, F&& on_unlock) {
+        if (ev.seat < 0 || ev.seat >= (int)unlocked.size()) return;
+        auto &bits = unlocked[ev.seat];
+        for (int r : subscribers[static_cast<int>(ev.type)]) {
+            if (bits.test(r)) continue;
+            if (!rules[r].pred.eval(ev)) continue;
+            bits.set(r);
+            on_unlock(ev.seat, r);
+        }
+    }
+    // Evaluate a whole round's worth of queued events for every seat in one pass
+    template <typename F>
+    void dispatch_batch(const std::vector<EventContext>& events, F&& on_unlock) {
+        for (const auto &ev : events) dispatch(ev, on_unlock);
+    }
+};
+
+static void load_achievement_definitions(AchievementEngine& engine) {
+    std::istringstream builtin(kBuiltinAchievements);
+    engine.load_definitions(builtin, "builtin");
+    std::ifstream cfg(kAchievementsConfigFile);
+    if (cfg) engine.load_definitions(cfg, kAchievementsConfigFile);
+}
+
+// -----------------------------
+// Varints for compact binary files: LEB128, signed values zigzag-encoded first
+// -----------------------------
+static const int kMaxVarintBytes = 10;
+
+static std::uint64_t zigzag(std::int64_t v) { return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63); }
+
+// Writes v at out (room for kMaxVarintBytes) and returns the number of bytes used
+static int put_varint(unsigned char* out, std::uint64_t v) {
+    int n = 0;
+    for (; v >= 0x80; v >>= 7) out[n++] = static_cast<unsigned char>(v | 0x80);
+    out[n++] = static_cast<unsigned char>(v);
+    return n;
+}
+
+// Fixed-width little-endian integer at p
+template <typename T>
+static T get_le(const unsigned char* p) {
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) v |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+    return static_cast<T>(v);
+}
+
+// -----------------------------
+// Chip ledger: fixed-capacity ring of recent records, older records spill to an append-only file
+//   file := "BJLG" version:u8 record*
+// A spill file without this header (an older layout) is renamed to <path>.old and started over.
+// -----------------------------
+enum class LedgerReason : std::uint8_t { Bet = 0, Payout = 1, Reset = 2, Rebuy = 3 };
+static const std::array<std::string,4> LedgerReasonNames = {"bet","payout","reset","rebuy"};
+static const char kLedgerMagic[4] = {'B','J','L','G'};
+static const std::uint8_t kLedgerVersion = 1;
+
+struct LedgerRecord {
+    std::int64_t round = 0;
+    int player = 0;     // profile id
+    Chips amount = 0;   // signed chip delta for the player
+    LedgerReason reason = LedgerReason::Bet;
+};
+
+class ChipLedger {
+public:
+    static const std::size_t kCapacity = 256;
+
+private:
+    std::array<LedgerRecord,kCapacity> ring;
+    std::uint64_t next_seq = 0;      // sequence number of the next record
+    std::uint64_t spilled_seq = 0;   // every record below this is already on disk
+    std::string spill_path;          // empty: no spill, records past the ring are dropped
+    std::ofstream spill;
+
+    // Appends to a spill file in the current layout; anything else is rolled over first
+    bool open_spill() {
+        bool current = false;
+        if (std::filesystem::exists(spill_path) && std::filesystem::file_size(spill_path) > 0) {
+            std::ifstream in(spill_path, std::ios::binary);
+            char head[sizeof kLedgerMagic + 1] = {};
+            current = in.read(head, sizeof head) && std::equal(kLedgerMagic, kLedgerMagic + sizeof kLedgerMagic, head)
+                      && static_cast<std::uint8_t>(head[sizeof kLedgerMagic]) == kLedgerVersion;
+            in.close();
+            if (!current) {
+                std::error_code ec;
+                std::filesystem::rename(spill_path, spill_path + ".old", ec);
+                if (!ec) std::cerr << "Note: " << spill_path << " has an older layout; moved it to " << spill_path << ".old\n";
+            }
+        }
+        spill.open(spill_path, std::ios::binary | (current ? std::ios::app : std::ios::trunc));
+        if (!spill) return false;
+        if (!current) {
+            spill.write(kLedgerMagic, sizeof kLedgerMagic);
+            spill.put(static_cast<char>(kLedgerVersion));
+        }
+        return true;
+    }
+
+    // Varint round, varint player, reason byte, zigzag varint amount: typically 5-7 bytes
+    void write_record(const LedgerRecord& r) {
+        if (!spill.is_open() && !open_spill()) {
+            std::cerr << "Warning: cannot open " << spill_path << ", chip ledger will not be spilled\n";
+            spill_path.clear();
+            return;
+        }
+        unsigned char buf[3 * kMaxVarintBytes + 1];
+        int n = put_varint(buf, static_cast<std::uint64_t>(r.round));
+        n += put_varint(buf + n, static_cast<std::uint64_t>(r.player));
+        buf[n++] = static_cast<unsigned char>(r.reason);
+        n += put_varint(buf + n, zigzag(r.amount));
+        spill.write(reinterpret_cast<const char*>(buf), n);
+    }
+
+public:
+    explicit ChipLedger(const std::string& path) : spill_path(path) {}
+    ~ChipLedger() { flush(); }
+    ChipLedger(const ChipLedger&) = delete;
+    ChipLedger& operator=(const ChipLedger&) = delete;
+
+    void record(std::int64_t round, int player, Chips amount, LedgerReason reason) {
+        LedgerRecord &slot = ring[next_seq % kCapacity];
+        if (!spill_path.empty() && next_seq >= kCapacity && next_seq - kCapacity >= spilled_seq) {
+            write_record(slot);
+            spilled_seq = next_seq - kCapacity + 1;
+        }
+        slot = LedgerRecord{round, player, amount, reason};
+        ++next_seq;
+    }
+    // Write everything still only held in memory; records stay readable from the ring
+    void flush() {
+        if (spill_path.empty()) return;
+        for (std::uint64_t s = std::max(spilled_seq, next_seq > kCapacity ? next_seq - kCapacity : 0); s < next_seq; ++s)
+            write_record(ring[s % kCapacity]);
+        spilled_seq = next_seq;
+        if (spill.is_open()) spill.flush();
+    }
+    std::size_t size() const { return static_cast<std::size_t>(std::min<std::uint64_t>(next_seq, kCapacity)); }
+    std::uint64_t total_recorded() const { return next_seq; }
+    // i = 0 is the oldest record still in the ring, size()-1 the newest
+    const LedgerRecord& at(std::size_t i) const { return ring[(next_seq - size() + i) % kCapacity]; }
+};
+
+// -----------------------------
+// Chip conservation audit
+// The seat side is summed by delta in the balance primitive; the house side is settled once
+// per round from the pot and what the round's outcome says each winner is due, worked out
+// again from hands and bets rather than taken from the payout code. A wrong payout therefore
+// leaves the seats off against the house. A full re-sum of the balances only runs every
+// kFullRecountEvery rounds to verify the running seat total itself.
+// -----------------------------
+struct ChipAudit {
+    static const int kFullRecountEvery = 1000;
+
+    bool enabled = false;
+    Chips seat_total = 0;   // sum of all balances, maintained by delta in the balance primitive
+    Chips house_take = 0;   // pots received minus payouts due, settled once per round
+    Chips minted = 0;       // chips added or removed outside play (profile resets)
+    Chips baseline = 0;     // seat_total when the table was seated
+    std::int64_t rounds_checked = 0;
+    std::int64_t violations = 0;
+
+    void reset(Chips total) { seat_total = baseline = total; house_take = minted = 0; }
+    void on_balance_change(Chips amount, Chips new_balance, std::int64_t round, int seat) {
+        seat_total += amount;
+        if (enabled && new_balance < 0) report(round, "seat " + std::to_string(seat) + " balance went negative (" + std::to_string(new_balance) + ")");
+    }
+    void on_settle(Chips pot, Chips due) { house_take += pot - due; }
+    void on_mint(Chips amount) { minted += amount; }
+
+    void report(std::int64_t round, const std::string& what) {
+        ++violations;
+        std::cerr << BRED << "Audit: round " << round << ": " << what << RESET << "\n";
+    }
+    // Every chip in play is either at a seat or with the house, apart from resets
+    void check_round(std::int64_t round) {
+        if (!enabled) return;
+        ++rounds_checked;
+        Chips expected = baseline + minted;
+        if (seat_total + house_take != expected) {
+            report(round, "seats " + std::to_string(seat_total) + " + house " + std::to_string(house_take)
+                          + " != expected " + std::to_string(expected));
+        }
+    }
+    bool full_recount_due() const { return enabled && rounds_checked % kFullRecountEvery == 0; }
+    void check_recount(std::int64_t round, Chips actual) {
+        if (actual != seat_total) report(round, "recount " + std::to_string(actual) + " != running seat total " + std::to_string(seat_total));
+    }
+};
+
+// -----------------------------
+// Profile store: player names are interned once into dense ids; per-player state lives in
+// flat arrays indexed by id. The name map is only consulted when a name enters the game.
+// -----------------------------
+struct SessionStats {
+    std::int64_t wins = 0;
+    std::int64_t losses = 0;
+    std::int64_t ties = 0;
+    std::int64_t blackjacks = 0;
+    bool seated = false;
+};
+
+// Name escaping helpers (the stats file is whitespace separated)
+static std::string escape_name(const std::string& name) {
+    std::string out; for (char c : name) out.push_back(c==' ' ? '_' : c); return out;
+}
+static std::string unescape_name(const std::string& name) {
+    std::string out; for (char c : name) out.push_back(c=='_' ? ' ' : c); return out;
+}
+
+class ProfileStore {
+private:
+    std::map<std::string,int> ids;
+    std::vector<std::string> names;
+    std::vector<PlayerStats> stats;
+
+public:
+    int intern(const std::string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        int id = (int)names.size();
+        ids.emplace(name, id);
+        names.push_back(name);
+        stats.emplace_back();
+        return id;
+    }
+    int find(const std::string& name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? -1 : it->second;
+    }
+    int size() const { return (int)names.size(); }
+    const std::string& name_of(int id) const { return names[id]; }
+    PlayerStats& operator[](int id) { return stats[id]; }
+    const PlayerStats& operator[](int id) const { return stats[id]; }
+
+    void load(const std::string& filename) {
+        std::ifstream in(filename);
+        if (!in) return;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+            std::istringstream iss(line);
+            std::string rawname;
+            PlayerStats ps;
+            if (!(iss >> rawname >> ps.wins >> ps.losses >> ps.ties >> ps.best_streak >> ps.current_streak >> ps.biggest_win >> ps.total_games >> ps.blackjacks)) continue;
+            std::string rest;
+            if (std::getline(iss, rest)) {
+                size_t pos=0; while (pos<rest.size() && std::isspace((unsigned char)rest[pos])) ++pos;
+                if (pos<rest.size()) {
+                    ps.achievements = split_achievements(rest.substr(pos));
+                }
+            }
+            stats[intern(unescape_name(rawname))] = ps;
+        }
+    }
+    void save(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::trunc);
+        if (!out) { std::cerr << "Warning: cannot save player stats\n"; return; }
+        for (int id = 0; id < size(); ++id) {
+            const PlayerStats &ps = stats[id];
+            out << escape_name(names[id]) << " "
+                << ps.wins << " " << ps.losses << " " << ps.ties << " "
+                << ps.best_streak << " " << ps.current_streak << " "
+                << ps.biggest_win << " " << ps.total_games << " "
+                << ps.blackjacks;
+            if (!ps.achievements.empty()) out << " " << join_achievements(ps.achievements);
+            out << "\n";
+        }
+    }
+};
+
+// One profile store for every table in a server process. A table checks its players' stats out
+// when they sit down and back in after each round; a name can be seated at only one table.
+class SharedProfiles {
+private:
+    mutable std::mutex m;
+    ProfileStore store;
+    std::set<std::string> seated;
+    std::string filename;
+    bool dirty = false;
+
+public:
+    explicit SharedProfiles(std::string file) : filename(std::move(file)) { store.load(filename); }
+
+    bool claim(const std::string& name) { std::lock_guard<std::mutex> lock(m); return seated.insert(name).second; }
+    void release(const std::string& name) { std::lock_guard<std::mutex> lock(m); seated.erase(name); }
+    PlayerStats checkout(const std::string& name) {
+        std::lock_guard<std::mutex> lock(m);
+        return store[store.intern(name)];
+    }
+    void checkin(const std::string& name, const PlayerStats& ps) {
+        std::lock_guard<std::mutex> lock(m);
+        store[store.intern(name)] = ps;
+        dirty = true;
+    }
+    // Writes a snapshot, so tables aren't held up by the file I/O
+    void save() {
+        ProfileStore snapshot;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (!dirty) return;
+            snapshot = store;
+            dirty = false;
+        }
+        snapshot.save(filename);
+    }
+};
+
 // -----------------------------
 // Deck class (uses deque + stack for discard, set for seen)
 // -----------------------------
@@ -219,15 +1081,22 @@ struct Deck {
     std::set<std::string> seen_cards;
     std::mt19937 rng;
     int decks = 1;
+    int running_count = 0;   // hi-lo count of the cards dealt since the last shuffle
 
     Deck(int decks_count = 1) : decks(decks_count) {
         std::random_device rd;
         rng.seed(static_cast<unsigned int>(rd() ^ (unsigned int)std::chrono::high_resolution_clock::now().time_since_epoch().count()));
         build_new_deck();
     }
+    // Deterministic shuffles for a recorded table; stream separates this rng from the game's
+    void seed(std::uint64_t s, std::uint32_t stream) {
+        std::seed_seq seq{static_cast<std::uint32_t>(s), static_cast<std::uint32_t>(s >> 32), stream};
+        rng.seed(seq);
+    }
     void build_new_deck() {
         container.clear();
         seen_cards.clear();
+        running_count = 0;
         for (int d = 0; d < decks; ++d) {
             for (int s = 0; s < 4; ++s) {
                 for (int r = 0; r < 13; ++r) {
@@ -255,6 +1124,7 @@ struct Deck {
                     discard.pop();
                 }
                 discard.push(top);
+                running_count = 0;
                 shuffle_deck();
             } else {
                 build_new_deck();
@@ -264,51 +1134,505 @@ struct Deck {
         Card c = container.front();
         container.pop_front();
         seen_cards.insert(c.canonical());
+        running_count += c.hilo();
         return c;
     }
     void discard_card(const Card& c) { discard.push(c); }
     std::size_t size() const { return container.size(); }
-};
-
-// -----------------------------
-// Dealer (colored lines and rotation of phrases)
-// -----------------------------
-struct Dealer {
-    std::deque<std::string> good_luck_lines{
-        "Good luck! May the cards favor you.",
-        "Let's see if lady luck is smiling at you.",
-        "Shuffle up and deal! Time to win big."
-    };
-    std::deque<std::string> encouragement_lines{
-        "You're close to 21, careful now!",
-        "Nice hand — don't push your luck!",
-        "Almost there, tension is high!"
-    };
-    std::deque<std::string> snarky_lines{
-        "Ouch! That must hurt.",
-        "Better luck next time, rookie.",
-        "I knew that wasn't going to work out."
-    };
+    // Running count per deck remaining
+    double true_count() const { return container.empty() ? 0.0 : running_count * 52.0 / static_cast<double>(container.size()); }
 
-    void say_good_luck() {
-        std::cout << BBLUE << "Dealer: " << RESET << BWHITE << good_luck_lines.front() << RESET << "\n";
-        std::rotate(good_luck_lines.begin(), good_luck_lines.begin()+1, good_luck_lines.end());
-    }
-    void say_encouragement() {
-        std::cout << BCYAN << "Dealer: " << RESET << BWHITE << encouragement_lines.front() << RESET << "\n";
-        std::rotate(encouragement_lines.begin(), encouragement_lines.begin()+1, encouragement_lines.end());
+    // Shoe state for checkpoints: rng stream position, cards left, discard pile and seen set
+    void save_state(std::ostream& os) const {
+        os << decks << '\n' << rng << '\n' << container.size();
+        for (auto &c : container) os << ' ' << c.canonical();
+        std::stack<Card> d = discard;
+        std::vector<Card> bottom_up;
+        for (; !d.empty(); d.pop()) bottom_up.push_back(d.top());
+        os << '\n' << bottom_up.size();
+        for (auto it = bottom_up.rbegin(); it != bottom_up.rend(); ++it) os << ' ' << it->canonical();
+        os << '\n' << seen_cards.size();
+        for (auto &s : seen_cards) os << ' ' << s;
+        os << '\n' << running_count << '\n';
     }
-    void say_snarky() {
-        std::cout << BRED << "Dealer: " << RESET << BWHITE << snarky_lines.front() << RESET << "\n";
-        std::rotate(snarky_lines.begin(), snarky_lines.begin()+1, snarky_lines.end());
+    void load_state(std::istream& is) {
+        auto read_card = [&is]() {
+            std::string tok;
+            is >> tok;
+            std::size_t dash = tok.rfind('-');
+            if (dash == std::string::npos || RankValue.find(tok.substr(0, dash)) == RankValue.end()) {
+                is.setstate(std::ios::failbit);
+                return Card();
+            }
+            return Card(tok.substr(0, dash), static_cast<Suit>(std::stoi(tok.substr(dash + 1)) & 3));
+        };
+        std::size_t n = 0;
+        is >> decks >> rng >> n;
+        container.clear();
+        for (std::size_t i = 0; i < n && is; ++i) container.push_back(read_card());
+        discard = std::stack<Card>();
+        is >> n;
+        for (std::size_t i = 0; i < n && is; ++i) discard.push(read_card());
+        seen_cards.clear();
+        is >> n;
+        for (std::size_t i = 0; i < n && is; ++i) { std::string s; is >> s; seen_cards.insert(s); }
+        is >> running_count;
     }
 };
 
 // -----------------------------
-// NPC decision helpers (personalities)
+// Columnar hand history: one row per seat per round. Rows are buffered per column and
+// written in chunks of kHistoryChunkRows; each chunk starts with a header that lists every
+// column's byte length and min/max, so a scan can skip a chunk (or a column) by seeking.
+//
+//   chunk  := "BJHC" rows:u32 columns:u16 { id:u8 width:u8 bytes:u64 min:i64 max:i64 }* data
+//   data   := the column blocks in header order, fixed-width little-endian values;
+//             Cards is variable length (NCards bytes per row, rank*4+suit)
 // -----------------------------
-bool cautious_carl_should_hit(const Player& p) { return p.hand_value() < 13; }
-bool reckless_randy_should_hit(const Player& p) { return p.hand_value() < 20; }
+enum class HistoryColumn : std::uint8_t {
+    Round = 0, Seat, Personality, StartValue, Upcard, NCards, Cards, Decisions,
+    FinalValue, Bet, Payout, ShoePos, TrueCount, Outcome, Count
+};
+static const int kHistoryColumnCount = static_cast<int>(HistoryColumn::Count);
+static const std::array<std::string,kHistoryColumnCount> HistoryColumnNames = {
+    "round","seat","personality","start","upcard","ncards","cards","decisions",
+    "final","bet","payout","shoe_pos","true_count","outcome"};
+// Bytes per value; Cards holds one byte per card rather than one per row
+static const std::array<int,kHistoryColumnCount> HistoryColumnWidth = {8,1,1,1,1,1,1,1,1,8,8,2,2,1};
+static const char kHistoryChunkMagic[4] = {'B','J','H','C'};
+static const std::uint32_t kHistoryChunkRows = 65536;
+
+enum class HandOutcome : std::uint8_t { Loss = 0, Win = 1, Bust = 2 };
+static const std::array<std::string,3> HandOutcomeNames = {"loss","win","bust"};
+// Decisions byte: number of hits in the low six bits, 0x40 when the seat stood
+static const std::uint8_t kDecisionStood = 0x40;
+
+struct HandRow {
+    std::int64_t round = 0;
+    int seat = 0;
+    Personality personality = Personality::Default;
+    int start_value = 0;      // value of the first two cards
+    int upcard = 0;           // highest first card showing at the other seats (what Smart reads)
+    std::vector<std::uint8_t> cards;
+    std::uint8_t decisions = 0;
+    int final_value = 0;
+    Chips bet = 0;
+    Chips payout = 0;
+    int shoe_pos = 0;         // cards left in the shoe when the round was dealt
+    double true_count = 0.0;  // stored as tenths
+    HandOutcome outcome = HandOutcome::Loss;
+};
+
+class HandHistoryWriter {
+private:
+    struct Column {
+        std::vector<unsigned char> data;
+        std::int64_t min = std::numeric_limits<std::int64_t>::max();
+        std::int64_t max = std::numeric_limits<std::int64_t>::min();
+        void append(std::int64_t v, int width) {
+            for (int i = 0; i < width; ++i) data.push_back(static_cast<unsigned char>(static_cast<std::uint64_t>(v) >> (8 * i)));
+            min = std::min(min, v);
+            max = std::max(max, v);
+        }
+        void reset() {
+            data.clear();
+            min = std::numeric_limits<std::int64_t>::max();
+            max = std::numeric_limits<std::int64_t>::min();
+        }
+    };
+    std::ofstream file;
+    std::array<Column,kHistoryColumnCount> cols;
+    std::uint32_t rows = 0;
+    std::uint64_t rows_written = 0;
+    std::uint64_t bytes = 0;   // file size after the last flush
+
+    template <typename T>
+    void put(T v) {
+        unsigned char buf[sizeof(T)];
+        for (std::size_t i = 0; i < sizeof(T); ++i) buf[i] = static_cast<unsigned char>(static_cast<std::uint64_t>(v) >> (8 * i));
+        file.write(reinterpret_cast<const char*>(buf), sizeof buf);
+    }
+    void add(HistoryColumn c, std::int64_t v) { cols[static_cast<int>(c)].append(v, HistoryColumnWidth[static_cast<int>(c)]); }
+
+public:
+    explicit HandHistoryWriter(const std::string& path) : file(path, std::ios::binary | std::ios::app) {
+        if (!file) throw std::runtime_error("cannot open hand history file " + path);
+        bytes = std::filesystem::file_size(path);
+    }
+    ~HandHistoryWriter() { flush(); }
+    HandHistoryWriter(const HandHistoryWriter&) = delete;
+    HandHistoryWriter& operator=(const HandHistoryWriter&) = delete;
+
+    void append(const HandRow& r) {
+        add(HistoryColumn::Round, r.round);
+        add(HistoryColumn::Seat, r.seat);
+        add(HistoryColumn::Personality, static_cast<int>(r.personality));
+        add(HistoryColumn::StartValue, r.start_value);
+        add(HistoryColumn::Upcard, r.upcard);
+        add(HistoryColumn::NCards, static_cast<std::int64_t>(std::min<std::size_t>(r.cards.size(), 255)));
+        for (std::size_t i = 0; i < r.cards.size() && i < 255; ++i) add(HistoryColumn::Cards, r.cards[i]);
+        add(HistoryColumn::Decisions, r.decisions);
+        add(HistoryColumn::FinalValue, r.final_value);
+        add(HistoryColumn::Bet, r.bet);
+        add(HistoryColumn::Payout, r.payout);
+        add(HistoryColumn::ShoePos, r.shoe_pos);
+        add(HistoryColumn::TrueCount, static_cast<std::int64_t>(std::lround(r.true_count * 10.0)));
+        add(HistoryColumn::Outcome, static_cast<int>(r.outcome));
+        if (++rows == kHistoryChunkRows) flush();
+    }
+    // Writes the buffered rows as one chunk
+    void flush() {
+        if (rows == 0) return;
+        file.write(kHistoryChunkMagic, sizeof kHistoryChunkMagic);
+        put<std::uint32_t>(rows);
+        put<std::uint16_t>(kHistoryColumnCount);
+        bytes += sizeof kHistoryChunkMagic + 4 + 2 + kHistoryColumnCount * (1 + 1 + 8 + 8 + 8);
+        for (int c = 0; c < kHistoryColumnCount; ++c) {
+            put<std::uint8_t>(static_cast<std::uint8_t>(c));
+            put<std::uint8_t>(static_cast<std::uint8_t>(HistoryColumnWidth[c]));
+            put<std::uint64_t>(cols[c].data.size());
+            bool empty = cols[c].data.empty();
+            put<std::int64_t>(empty ? 0 : cols[c].min);
+            put<std::int64_t>(empty ? 0 : cols[c].max);
+        }
+        for (auto &col : cols) {
+            file.write(reinterpret_cast<const char*>(col.data.data()), static_cast<std::streamsize>(col.data.size()));
+            bytes += col.data.size();
+            col.reset();
+        }
+        file.flush();
+        rows_written += rows;
+        rows = 0;
+    }
+    std::uint64_t total_rows() const { return rows_written + rows; }
+    // Bytes on disk once flushed; a checkpoint records this so a resume can cut off later chunks
+    std::uint64_t flushed_bytes() const { return bytes; }
+};
+
+// -----------------------------
+// Binary event log: every bet, deal, decision and payout as a compact byte stream.
+// Each event is a header byte (type << 5 | seat), seat 31 escaping to a varint seat,
+// followed by a one-byte card or a varint amount. A typical hand costs 10-13 bytes.
+// The engine thread encodes a round into a local buffer and publishes it to an SPSC
+// byte ring once per round; a background thread drains the ring to the file.
+// The header holds the table's seed and setup, so the log plus the engine replays the
+// session; every round ends with a digest of the table state to detect divergence.
+// A sidecar <log>.idx holds (round:u64, offset:u64) for every kEventIndexEvery-th round.
+//
+//   file   := "BJEV" version:u8 header event*
+//   header := varint(seed) flags:u8 varint(npc_seats) varint(starting) varint(bet) varint(decks)
+//             varint(seats) zigzag-varint(current_streak)*seats
+//   event  := Round/begin varint(round) | Round/end digest:u32 | Deal/Hit/Discard card:u8
+//           | Stand | Bet/Payout varint(chips) | Adjust zigzag-varint(chips)
+// -----------------------------
+enum class LogEvent : std::uint8_t { Round = 0, Deal, Hit, Stand, Discard, Bet, Payout, Adjust };
+static const char kEventLogMagic[4] = {'B','J','E','V'};
+static const std::uint8_t kEventLogVersion = 2;
+static const int kEventSeatEscape = 31;
+static const int kRoundBegin = 0, kRoundEnd = 1;   // "seat" bits of a Round event
+static const std::int64_t kEventIndexEvery = 1024;
+
+// Table setup recorded at the head of a log
+struct EventLogHeader {
+    enum : std::uint8_t { HumanSeat = 1, Rebuy = 2, StartupShoe = 4 };
+    std::uint64_t seed = 0;
+    std::uint8_t flags = 0;
+    int npc_seats = 0;
+    Chips starting_chips = 0;
+    Chips bet = 0;
+    int decks = 1;
+    std::vector<std::int64_t> streaks;   // per seat; the Smart NPC bets on its profile's streak
+};
+
+class EventLogWriter {
+private:
+    static const std::size_t kRingBytes = std::size_t(1) << 20;   // power of two
+
+    std::unique_ptr<unsigned char[]> ring;
+    alignas(64) std::atomic<std::uint64_t> head{0};   // bytes published, written by the engine thread
+    alignas(64) std::atomic<std::uint64_t> tail{0};   // bytes written to disk, written by the writer thread
+    std::atomic<bool> closing{false};
+    std::vector<unsigned char> pending;               // the current round, engine thread only
+    std::uint64_t logical_bytes = 0;                  // file size once everything published is drained
+    std::uint64_t hands = 0;
+    bool need_header = false;
+    bool index_dirty = false;
+    std::string index_path;
+    std::ofstream index;
+    std::ofstream file;
+    std::thread writer;
+
+    void header(LogEvent type, int seat) {
+        if (seat < kEventSeatEscape) { pending.push_back(static_cast<unsigned char>(static_cast<int>(type) << 5 | seat)); return; }
+        pending.push_back(static_cast<unsigned char>(static_cast<int>(type) << 5 | kEventSeatEscape));
+        varint(static_cast<std::uint64_t>(seat));
+    }
+    void varint(std::uint64_t v) {
+        unsigned char buf[kMaxVarintBytes];
+        pending.insert(pending.end(), buf, buf + put_varint(buf, v));
+    }
+    // Copies bytes into the ring, waiting for the writer only if the ring is full
+    void publish(const unsigned char* p, std::size_t n) {
+        std::uint64_t h = head.load(std::memory_order_relaxed);
+        while (n) {
+            std::uint64_t free = kRingBytes - (h - tail.load(std::memory_order_acquire));
+            if (free == 0) { std::this_thread::yield(); continue; }
+            std::size_t at = static_cast<std::size_t>(h & (kRingBytes - 1));
+            std::size_t len = static_cast<std::size_t>(std::min<std::uint64_t>({n, free, kRingBytes - at}));
+            std::memcpy(ring.get() + at, p, len);
+            p += len; n -= len; h += len;
+            head.store(h, std::memory_order_release);
+        }
+    }
+    void drain() {
+        bool dirty = false;
+        while (true) {
+            std::uint64_t t = tail.load(std::memory_order_relaxed);
+            std::uint64_t h = head.load(std::memory_order_acquire);
+            if (h == t) {
+                if (closing.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == t) break;
+                if (dirty) { file.flush(); dirty = false; }   // idle: push what we have to the OS
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            dirty = true;
+            std::size_t at = static_cast<std::size_t>(t & (kRingBytes - 1));
+            std::size_t len = static_cast<std::size_t>(std::min<std::uint64_t>(h - t, kRingBytes - at));
+            file.write(reinterpret_cast<const char*>(ring.get() + at), static_cast<std::streamsize>(len));
+            tail.store(t + len, std::memory_order_release);
+        }
+        file.flush();
+    }
+
+public:
+    // A fresh log replaces whatever is at path; append continues a resumed one, whose
+    // index loses the entries that pointed into the cut-off tail
+    explicit EventLogWriter(const std::string& path, bool append = false) : ring(new unsigned char[kRingBytes]), index_path(path + ".idx") {
+        need_header = !append || !std::filesystem::exists(path) || std::filesystem::file_size(path) == 0;
+        file.open(path, std::ios::binary | (need_header ? std::ios::trunc : std::ios::app));
+        if (!file) throw std::runtime_error("cannot open event log " + path);
+        logical_bytes = need_header ? 0 : std::filesystem::file_size(path);
+        std::vector<unsigned char> kept;
+        if (!need_header) {
+            std::ifstream old(index_path, std::ios::binary);
+            unsigned char entry[16];
+            while (old.read(reinterpret_cast<char*>(entry), sizeof entry))
+                if (get_le<std::uint64_t>(entry + 8) < logical_bytes) kept.insert(kept.end(), entry, entry + sizeof entry);
+        }
+        index.open(index_path, std::ios::binary | std::ios::trunc);
+        if (!index) throw std::runtime_error("cannot open event index " + index_path);
+        index.write(reinterpret_cast<const char*>(kept.data()), static_cast<std::streamsize>(kept.size()));
+        index.flush();
+        writer = std::thread([this] { drain(); });
+    }
+    ~EventLogWriter() { close(); }
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter& operator=(const EventLogWriter&) = delete;
+
+    // An appended (resumed) log already has its header
+    bool needs_header() const { return need_header; }
+    void write_header(const EventLogHeader& h) {
+        pending.insert(pending.end(), kEventLogMagic, kEventLogMagic + sizeof kEventLogMagic);
+        pending.push_back(kEventLogVersion);
+        varint(h.seed);
+        pending.push_back(h.flags);
+        varint(static_cast<std::uint64_t>(h.npc_seats));
+        varint(static_cast<std::uint64_t>(h.starting_chips));
+        varint(static_cast<std::uint64_t>(h.bet));
+        varint(static_cast<std::uint64_t>(h.decks));
+        varint(h.streaks.size());
+        for (auto v : h.streaks) varint(zigzag(v));
+        need_header = false;
+    }
+    void round_start(std::int64_t round) {
+        commit();
+        if ((round - 1) % kEventIndexEvery == 0) {
+            unsigned char entry[16];
+            for (int i = 0; i < 8; ++i) entry[i] = static_cast<unsigned char>(static_cast<std::uint64_t>(round) >> (8 * i));
+            for (int i = 0; i < 8; ++i) entry[8 + i] = static_cast<unsigned char>(logical_bytes >> (8 * i));
+            index.write(reinterpret_cast<const char*>(entry), sizeof entry);
+            index_dirty = true;
+        }
+        header(LogEvent::Round, kRoundBegin);
+        varint(static_cast<std::uint64_t>(round));
+    }
+    void round_end(std::uint32_t digest) {
+        header(LogEvent::Round, kRoundEnd);
+        for (int i = 0; i < 4; ++i) pending.push_back(static_cast<unsigned char>(digest >> (8 * i)));
+    }
+    void card(LogEvent type, int seat, const Card& c) { header(type, seat); pending.push_back(c.to_byte()); }
+    void stand(int seat) { header(LogEvent::Stand, seat); }
+    void chips(LedgerReason reason, int seat, Chips amount) {
+        switch (reason) {
+            case LedgerReason::Bet: header(LogEvent::Bet, seat); varint(static_cast<std::uint64_t>(-amount)); ++hands; break;
+            case LedgerReason::Payout: header(LogEvent::Payout, seat); varint(static_cast<std::uint64_t>(amount)); break;
+            default: header(LogEvent::Adjust, seat); varint(zigzag(amount)); break;
+        }
+    }
+    // Hands the buffered events to the writer thread and pushes new index entries to the OS
+    void commit() {
+        if (index_dirty) { index.flush(); index_dirty = false; }
+        if (pending.empty()) return;
+        publish(pending.data(), pending.size());
+        logical_bytes += pending.size();
+        pending.clear();
+    }
+    // Commits, drains and closes the file; safe to call more than once
+    void close() {
+        if (!writer.joinable()) return;
+        commit();
+        closing.store(true, std::memory_order_release);
+        writer.join();
+        file.close();
+        index.close();
+    }
+    // File size once every committed event is on disk; checkpoints record this
+    std::uint64_t committed_bytes() const { return logical_bytes; }
+    std::uint64_t hands_logged() const { return hands; }
+};
+
+struct LoggedEvent {
+    LogEvent type = LogEvent::Round;
+    int seat = 0;              // for Round events: kRoundBegin or kRoundEnd
+    std::int64_t value = 0;    // round, digest, card byte or chip amount
+};
+
+// Sequential reader over a log file with its own read buffer; seek() jumps to an index offset
+class EventLogReader {
+private:
+    std::ifstream file;
+    std::vector<unsigned char> buf;
+    std::size_t pos = 0;
+    std::size_t len = 0;
+
+    bool byte(unsigned char& b) {
+        if (pos == len) {
+            file.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+            len = static_cast<std::size_t>(file.gcount());
+            pos = 0;
+            if (len == 0) return false;
+        }
+        b = buf[pos++];
+        return true;
+    }
+    bool varint(std::uint64_t& v) {
+        v = 0;
+        unsigned char b = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (!byte(b)) return false;
+            v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+    static std::int64_t unzigzag(std::uint64_t v) { return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1); }
+
+public:
+    explicit EventLogReader(const std::string& path) : file(path, std::ios::binary), buf(std::size_t(1) << 16) {
+        if (!file) throw std::runtime_error("cannot open event log " + path);
+    }
+    void read_header(EventLogHeader& h) {
+        unsigned char magic[4], version = 0, flags = 0;
+        for (auto &m : magic) if (!byte(m)) throw std::runtime_error("event log too short");
+        if (!std::equal(magic, magic + 4, kEventLogMagic) || !byte(version) || version != kEventLogVersion)
+            throw std::runtime_error("not a version " + std::to_string(kEventLogVersion) + " event log");
+        std::uint64_t v[6];
+        bool ok = varint(v[0]) && byte(flags);
+        for (int i = 1; i < 6 && ok; ++i) ok = varint(v[i]);
+        if (!ok || v[5] > static_cast<std::uint64_t>(kMaxSeats)) throw std::runtime_error("corrupt event log header");
+        h.seed = v[0];
+        h.flags = flags;
+        h.npc_seats = static_cast<int>(v[1]);
+        h.starting_chips = static_cast<Chips>(v[2]);
+        h.bet = static_cast<Chips>(v[3]);
+        h.decks = static_cast<int>(v[4]);
+        h.streaks.resize(v[5]);
+        for (auto &s : h.streaks) {
+            std::uint64_t z = 0;
+            if (!varint(z)) throw std::runtime_error("corrupt event log header");
+            s = unzigzag(z);
+        }
+    }
+    void seek(std::uint64_t offset) {
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(offset));
+        pos = len = 0;
+    }
+    // False at the end of the log (a torn final event also ends it)
+    bool next(LoggedEvent& e) {
+        unsigned char h = 0, b = 0;
+        if (!byte(h)) return false;
+        e.type = static_cast<LogEvent>(h >> 5);
+        e.seat = h & kEventSeatEscape;
+        std::uint64_t v = 0;
+        if (e.seat == kEventSeatEscape) { if (!varint(v)) return false; e.seat = static_cast<int>(v); }
+        switch (e.type) {
+            case LogEvent::Round:
+                if (e.seat == kRoundBegin) { if (!varint(v)) return false; e.value = static_cast<std::int64_t>(v); }
+                else {
+                    std::uint32_t d = 0;
+                    for (int i = 0; i < 4; ++i) { if (!byte(b)) return false; d |= static_cast<std::uint32_t>(b) << (8 * i); }
+                    e.value = d;
+                }
+                break;
+            case LogEvent::Deal: case LogEvent::Hit: case LogEvent::Discard:
+                if (!byte(b)) return false;
+                e.value = b;
+                break;
+            case LogEvent::Stand: e.value = 0; break;
+            case LogEvent::Bet: case LogEvent::Payout:
+                if (!varint(v)) return false;
+                e.value = static_cast<std::int64_t>(v);
+                break;
+            case LogEvent::Adjust:
+                if (!varint(v)) return false;
+                e.value = unzigzag(v);
+                break;
+        }
+        return true;
+    }
+};
+
+// -----------------------------
+// Dealer (colored lines and rotation of phrases)
+// -----------------------------
+struct Dealer {
+    std::ostream* out = &std::cout;
+    std::deque<std::string> good_luck_lines{
+        "Good luck! May the cards favor you.",
+        "Let's see if lady luck is smiling at you.",
+        "Shuffle up and deal! Time to win big."
+    };
+    std::deque<std::string> encouragement_lines{
+        "You're close to 21, careful now!",
+        "Nice hand — don't push your luck!",
+        "Almost there, tension is high!"
+    };
+    std::deque<std::string> snarky_lines{
+        "Ouch! That must hurt.",
+        "Better luck next time, rookie.",
+        "I knew that wasn't going to work out."
+    };
+
+    void say_good_luck() {
+        *out << BBLUE << "Dealer: " << RESET << BWHITE << good_luck_lines.front() << RESET << "\n";
+        std::rotate(good_luck_lines.begin(), good_luck_lines.begin()+1, good_luck_lines.end());
+    }
+    void say_encouragement() {
+        *out << BCYAN << "Dealer: " << RESET << BWHITE << encouragement_lines.front() << RESET << "\n";
+        std::rotate(encouragement_lines.begin(), encouragement_lines.begin()+1, encouragement_lines.end());
+    }
+    void say_snarky() {
+        *out << BRED << "Dealer: " << RESET << BWHITE << snarky_lines.front() << RESET << "\n";
+        std::rotate(snarky_lines.begin(), snarky_lines.begin()+1, snarky_lines.end());
+    }
+};
+
+// -----------------------------
+// NPC decision helpers (personalities)
+// -----------------------------
+bool cautious_carl_should_hit(const Player& p) { return p.hand_value() < 13; }
+bool reckless_randy_should_hit(const Player& p) { return p.hand_value() < 20; }
 bool chaotic_chad_should_hit(const Player& p, std::mt19937 &rng) {
     std::uniform_int_distribution<int> d(0,1); return d(rng) == 1;
 }
@@ -346,6 +1670,232 @@ bool smart_samantha_should_hit(const Player& p, const std::list<Player>& all_pla
     return hv < 12;
 }
 
+// -----------------------------
+// Bot protocol messages: one JSON object per line, built in a fixed buffer (numbers through
+// std::to_chars) and handed to the stream buffer in a single write, so nothing is allocated
+// unless a line outgrows the buffer (a long escaped name); it then continues on the heap.
+// -----------------------------
+class JsonLine {
+private:
+    char buf[4096];
+    std::size_t len = 0;
+    std::string spill;      // the whole line once it no longer fits in buf
+    bool need_comma = false;
+
+    void put(char c) { put(std::string_view(&c, 1)); }
+    void put(std::string_view v) {
+        if (spill.empty() && len + v.size() <= sizeof buf) {
+            std::memcpy(buf + len, v.data(), v.size());
+            len += v.size();
+            return;
+        }
+        if (spill.empty()) spill.assign(buf, len);
+        spill.append(v);
+    }
+    void key(const char* k) {
+        if (need_comma) put(',');
+        need_comma = true;
+        if (!k) return;
+        put('"'); put(k); put("\":");
+    }
+    void quoted(std::string_view v) {
+        put('"');
+        for (char c : v) {
+            if (c == '"' || c == '\\') { put('\\'); put(c); }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                static const char hex[] = "0123456789abcdef";
+                put("\\u00"); put(hex[(c >> 4) & 0xf]); put(hex[c & 0xf]);
+            } else put(c);
+        }
+        put('"');
+    }
+
+public:
+    JsonLine() { put('{'); }
+    explicit JsonLine(const char* type) : JsonLine() { str("type", type); }
+
+    JsonLine& num(const char* k, std::int64_t v) {
+        key(k);
+        char digits[24];
+        auto r = std::to_chars(digits, digits + sizeof digits, v);
+        put(std::string_view(digits, static_cast<std::size_t>(r.ptr - digits)));
+        return *this;
+    }
+    JsonLine& str(const char* k, std::string_view v) { key(k); quoted(v); return *this; }
+    JsonLine& flag(const char* k, bool v) { key(k); put(v ? "true" : "false"); return *this; }
+    JsonLine& card(const char* k, const Card& c) {
+        key(k);
+        put('"'); put(c.rank); put(SuitNames[static_cast<int>(c.suit)][0]); put('"');
+        return *this;
+    }
+    // "key":[ / "key":{ (no key inside an array); close with ']' or '}'
+    JsonLine& open(const char* k, char bracket) { key(k); put(bracket); need_comma = false; return *this; }
+    JsonLine& close(char bracket) { put(bracket); need_comma = true; return *this; }
+
+    void send(std::streambuf* sb) {
+        put("}\n");
+        if (spill.empty()) sb->sputn(buf, static_cast<std::streamsize>(len));
+        else sb->sputn(spill.data(), static_cast<std::streamsize>(spill.size()));
+        sb->pubsync();
+    }
+};
+
+// -----------------------------
+// Vyukov's intrusive MPSC queue: producers push with one atomic exchange and a store, the single
+// consumer pops without locks or CAS loops. Between a producer's exchange and its link store the
+// node is unreachable, so pop can report empty while a push is in flight; callers retry later.
+// -----------------------------
+template <typename T>
+class MpscQueue {
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+    alignas(64) std::atomic<Node*> head;   // last pushed; producers only
+    alignas(64) Node* tail;                // next to pop; consumer only
+    Node stub;
+
+    void push_node(Node* n) {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        Node *prev = head.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+    }
+
+public:
+    MpscQueue() : head(&stub), tail(&stub) {}
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+    ~MpscQueue() { T v; while (pop(v)) {} }
+
+    void push(T value) {
+        Node *n = new Node;
+        n->value = std::move(value);
+        push_node(n);
+    }
+
+    bool pop(T& out) {
+        Node *t = tail;
+        Node *next = t->next.load(std::memory_order_acquire);
+        if (t == &stub) {
+            if (!next) return false;
+            tail = next;
+            t = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (!next) {
+            // t is the last node: park the stub behind it so t can be unlinked
+            if (t != head.load(std::memory_order_acquire)) return false;   // a push is in flight
+            push_node(&stub);
+            next = t->next.load(std::memory_order_acquire);
+            if (!next) return false;
+        }
+        tail = next;
+        out = std::move(t->value);
+        delete t;
+        return true;
+    }
+};
+
+// One line from a remote seat; empty when the seat ran out of time to answer
+using SeatAction = std::optional<std::string>;
+
+// -----------------------------
+// Coroutine task for table code that waits on player input. A task starts suspended; awaiting
+// it runs it, and when it finishes control goes straight back to the coroutine that awaited it.
+// -----------------------------
+class Task {
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                std::coroutine_handle<> next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() const noexcept {}
+        };
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task() = default;
+    Task(Task&& o) noexcept : h(std::exchange(o.h, {})) {}
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o) { if (h) h.destroy(); h = std::exchange(o.h, {}); }
+        return *this;
+    }
+    ~Task() { if (h) h.destroy(); }   // a suspended task takes the tasks it is awaiting with it
+
+    explicit operator bool() const { return static_cast<bool>(h); }
+    bool done() const { return h.done(); }
+    void resume() { h.resume(); }
+    void result() const { if (h.promise().error) std::rethrow_exception(h.promise().error); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        h.promise().continuation = awaiting;
+        return h;
+    }
+    void await_resume() const { result(); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : h(handle) {}
+    std::coroutine_handle<promise_type> h;
+};
+
+// -----------------------------
+// Table configuration (interactive defaults; the simulator turns off the human seat and all output)
+// -----------------------------
+struct TableConfig {
+    Chips starting_chips = 100;
+    Chips bet = 10;
+    int decks = 1;
+    bool human_seat = true;
+    int npc_seats = 4;          // cycles through the four personalities
+    bool quiet = false;         // no table output and no pacing delays
+    bool persist = true;        // load/save player_stats.db and spill the chip ledger
+    bool rebuy = false;         // between rounds, top bankrupt seats back up instead of removing them
+    std::uint64_t seed = 0;     // 0 = pick one at random; the event log records the one used
+    bool paced = true;          // pause between actions so a person can follow the table
+    bool remote = false;        // the human seat isn't this process's terminal: q leaves the table instead of exiting
+    std::string human_name = "You";
+    std::string npc_tag;        // appended to NPC names, so tables sharing a profile store keep their own NPCs
+};
+
+static Player make_npc(int index) {
+    static const std::array<const char*,4> names = {"Cautious Carl","Reckless Randy","Smart Samantha","Chaotic Chad"};
+    static const std::array<std::array<const char*,2>,4> lines = {{
+        {"Mmm… 14 is too risky. I'll stand.", "I'll play it safe."},
+        {"Hit me again! Let's go!", "All in baby!"},
+        {"Statistics say I should hit here.", "I'll play the odds."},
+        {"Stand! No, hit! No wait—hit!", "Feeling unpredictable today."}
+    }};
+    int k = index % 4;
+    std::string name = names[k];
+    if (index >= 4) name += " " + std::to_string(index / 4 + 1);
+    Player p(name, false);
+    p.speech = {lines[k][0], lines[k][1]};
+    return p;
+}
+
+static void print_ev_line(std::ostream& os, const std::string& label, const EvStats& e) {
+    os << std::left << std::setw(20) << label << std::right;
+    if (e.net.count == 0) { os << " (no rounds)\n"; return; }
+    os << std::fixed << std::setprecision(2)
+       << " n=" << std::setw(9) << e.net.count
+       << "  net " << std::showpos << e.net.mean << std::noshowpos << " ± " << e.net.ci95() << " chips"
+       << "  (" << std::showpos << e.per_unit.mean * 100.0 << std::noshowpos << "% ± " << e.per_unit.ci95() * 100.0 << "% of wager)"
+       << std::defaultfloat << "\n";
+}
+
 // -----------------------------
 // BlackjackGame class
 // -----------------------------
@@ -353,193 +1903,369 @@ class BlackjackGame {
 private:
     Deck deck;
     Dealer dealer;
-    std::map<std::string, PlayerStats> persistent_stats;
-    std::map<std::string,int> stats_wins, stats_losses, stats_ties, stats_blackjacks;
+    ProfileStore profiles;
+    std::vector<SessionStats> session;   // indexed by profile id
     std::list<Player> players;
-    std::queue<std::string> turn_queue;
+    std::vector<Player*> seat_players;   // seat id -> player, nullptr once a seat is vacated
+    MpscQueue<SeatAction> turn_queue;   // the human seat's actions, posted from any thread
+    AchievementEngine achievements;
+    std::vector<EventContext> round_events;   // queued during a round, evaluated once at round end
 
     // Betting
-    std::deque<std::pair<std::string,int>> betting_pot;
-    std::queue<int> chip_transactions;
-    std::map<std::string,int> chip_map;
+    std::vector<Chips> seat_bets;   // this round's bet per seat id, filled in collect_bets
+    Chips pot = 0;                  // running total of seat_bets
+    ChipLedger ledger;
+    std::vector<Chips> balances;   // chips per seat id; the only copy of a seat's balance
+    ChipAudit audit;
+
+    // EV statistics
+    std::vector<Chips> seat_payouts;   // this round's payout per seat id
+    StatsShard ev;
+    std::vector<SeatWindows> windows;   // last-N-rounds stats per seat id
+
+    // Hand history (optional): shoe position and true count are captured when the round is dealt
+    HandHistoryWriter* history = nullptr;
+    int round_shoe_pos = 0;
+    double round_true_count = 0.0;
+    EventLogWriter* event_log = nullptr;   // optional binary event log
 
-    int starting_chips;
-    int bet_amount;
+    TableConfig config;
+    Chips starting_chips;
+    Chips bet_amount;
     int text_speed; // 0=fast,1=normal,2=slow
     bool dealer_upcard_mode;
     std::mt19937 rng;
     const std::string stats_filename = "player_stats.db";
+    std::int64_t current_round = 0;
+    std::ostream out{nullptr};          // std::cout's buffer, or none when quiet
+    std::istream* input = &std::cin;    // the human seat's decisions
+    SharedProfiles* shared_profiles = nullptr;
+    std::streambuf* bot = nullptr;      // bot protocol sink; the text UI is off while set
+    bool human_leaving = false;         // a remote seat asked to leave; the server ends its session
+
+    // Human input is awaited, not read: a coroutine asking for a line parks its handle here and
+    // whoever drives the table (run_blocking, or the server once the client answers) resumes it.
+    Task round_task;
+    std::coroutine_handle<> input_waiter;
+    std::optional<std::string> input_line;   // the answer; empty when input has ended
+
+    struct LineAwaiter {
+        BlackjackGame& game;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept { game.input_waiter = h; }
+        std::optional<std::string> await_resume() { return std::move(game.input_line); }
+    };
+    LineAwaiter next_line() { return LineAwaiter{*this}; }
+
+    // Runs a task on this thread, answering each input request with a line read from *input
+    void run_blocking(Task task) {
+        task.resume();
+        while (!task.done()) {
+            std::string line;
+            if (std::getline(*input, line)) provide_input(std::move(line));
+            else provide_input(std::nullopt);
+        }
+        task.result();
+    }
 
 public:
-    BlackjackGame(int starting=100, int bet=10, int decks=1)
-        : deck(decks), starting_chips(starting), bet_amount(bet), text_speed(1), dealer_upcard_mode(false) {
-        std::random_device rd;
-        rng.seed(static_cast<unsigned int>(rd() ^ (unsigned int)std::chrono::system_clock::now().time_since_epoch().count()));
+    BlackjackGame(Chips starting=100, Chips bet=10, int decks=1)
+        : BlackjackGame([&] { TableConfig c; c.starting_chips = starting; c.bet = bet; c.decks = decks; return c; }()) {}
+
+    explicit BlackjackGame(const TableConfig& cfg)
+        : deck(cfg.decks), ledger(cfg.persist ? "chip_ledger.bin" : ""), config(cfg), starting_chips(cfg.starting_chips), bet_amount(cfg.bet),
+          text_speed(1), dealer_upcard_mode(false) {
+        if (config.seed == 0) {
+            std::random_device rd;
+            config.seed = (static_cast<std::uint64_t>(rd()) << 32 | rd()) ^ static_cast<std::uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+        }
+        std::seed_seq seq{static_cast<std::uint32_t>(config.seed), static_cast<std::uint32_t>(config.seed >> 32), 0u};
+        rng.seed(seq);
+        deck.seed(config.seed, 1u);
+        set_quiet(config.quiet);
+        dealer.out = &out;
+        load_achievement_definitions(achievements);
         init_players();
         load_stats_from_file();
+        bind_achievement_seats();
+    }
+
+    void set_quiet(bool q) { config.quiet = q; out.rdbuf(q ? nullptr : std::cout.rdbuf()); }
+    void set_input(std::istream* in) { input = in; }
+    void set_output(std::streambuf* buf) { config.quiet = false; out.rdbuf(buf); }
+    void set_shared_profiles(SharedProfiles* store) { shared_profiles = store; load_stats_from_file(); bind_achievement_seats(); }
+    void set_bot_output(std::streambuf* sink) { bot = sink; config.quiet = true; out.rdbuf(nullptr); }
+    bool bot_mode() const { return bot != nullptr; }
+    // Seat actions for tables driven from outside: any thread may post, only the thread
+    // driving the table takes them (the server hands each table to one worker at a time)
+    void post_action(SeatAction action) { turn_queue.push(std::move(action)); }
+    bool next_action(SeatAction& action) { return turn_queue.pop(action); }
+    bool human_seated() const { return std::any_of(players.begin(), players.end(), [](const Player& p) { return p.is_human; }); }
+    bool leaving() const { return human_leaving; }
+    std::uint64_t seed() const { return config.seed; }
+    // Fresh shuffled shoe of the given size, as chosen at startup
+    void apply_shoe(int decks) {
+        config.decks = decks;
+        deck.decks = decks;
+        deck.build_new_deck();
+        deck.shuffle_deck();
     }
 
     // Startup config: shoe size, text speed, dealer upcard mode
     void startup_config() {
-        std::cout << BOLD << "Welcome to Blackjack (colored edition)!\n" << RESET;
-        std::cout << "Choose shoe size (1,2,4,6) decks [default 1]: ";
+        out << BOLD << "Welcome to Blackjack (colored edition)!\n" << RESET;
+        out << "Choose shoe size (1,2,4,6) decks [default 1]: ";
         int decks = 1; std::string line;
-        std::getline(std::cin, line);
+        std::getline(*input, line);
         if (!line.empty()) {
             try { decks = std::stoi(line); if (decks != 1 && decks !=2 && decks !=4 && decks !=6) decks = 1; }
             catch (...) { decks = 1; }
         }
-        deck.decks = decks;
-        deck.build_new_deck();
-        deck.shuffle_deck();
+        apply_shoe(decks);
 
-        std::cout << "Choose text speed: 0=Fast, 1=Normal, 2=Slow [default 1]: ";
-        std::getline(std::cin, line);
+        out << "Choose text speed: 0=Fast, 1=Normal, 2=Slow [default 1]: ";
+        std::getline(*input, line);
         if (!line.empty()) {
             try { int s = std::stoi(line); if (s>=0 && s<=2) text_speed = s; }
             catch (...) { text_speed = 1; }
         }
-        std::cout << "Enable dealer-upcard mode? (show only first card of NPCs) (y/n) [n]: ";
-        std::getline(std::cin, line);
+        out << "Enable dealer-upcard mode? (show only first card of NPCs) (y/n) [n]: ";
+        std::getline(*input, line);
         if (!line.empty() && (line[0]=='y' || line[0]=='Y')) dealer_upcard_mode = true;
     }
 
     void init_players() {
         players.clear();
-        players.emplace_back("You", true, starting_chips);
-
-        Player p1("Cautious Carl", false, starting_chips);
-        p1.speech = {"Mmm… 14 is too risky. I'll stand.", "I'll play it safe."};
-        players.push_back(p1);
-
-        Player p2("Reckless Randy", false, starting_chips);
-        p2.speech = {"Hit me again! Let's go!", "All in baby!"};
-        players.push_back(p2);
-
-        Player p3("Smart Samantha", false, starting_chips);
-        p3.speech = {"Statistics say I should hit here.", "I'll play the odds."};
-        players.push_back(p3);
-
-        Player p4("Chaotic Chad", false, starting_chips);
-        p4.speech = {"Stand! No, hit! No wait—hit!", "Feeling unpredictable today."};
-        players.push_back(p4);
+        if (config.human_seat) players.emplace_back(config.human_name, true);
+        for (int i = 0; i < config.npc_seats; ++i) { players.push_back(make_npc(i)); players.back().name += config.npc_tag; }
 
+        if ((int)players.size() > kMaxSeats) throw std::runtime_error("too many seats at the table");
+        int next_seat = 0;
+        seat_players.clear();
+        balances.assign(players.size(), starting_chips);
+        seat_bets.assign(players.size(), 0);
+        seat_payouts.assign(players.size(), 0);
+        ev = StatsShard{};
+        ev.resize(players.size());
+        windows.assign(players.size(), SeatWindows{});
+        audit.reset(starting_chips * static_cast<Chips>(players.size()));
         for (auto &p : players) {
-            stats_wins[p.name]=0; stats_losses[p.name]=0; stats_ties[p.name]=0; stats_blackjacks[p.name]=0;
-            if (persistent_stats.find(p.name) == persistent_stats.end()) persistent_stats[p.name] = PlayerStats{};
-            chip_map[p.name] = p.chips;
+            p.seat = next_seat++;
+            seat_players.push_back(&p);
+            p.id = profiles.intern(p.name);
         }
+        session.assign(profiles.size(), SessionStats{});
+        for (auto &p : players) session[p.id].seated = true;
     }
 
     // Persistence: save/load
+    // With a shared store, seated players are checked out of it and back in instead of using the file
     void load_stats_from_file() {
-        std::ifstream in(stats_filename);
-        if (!in) return;
-        std::string line;
-        while (std::getline(in, line)) {
-            if (line.empty()) continue;
-            std::istringstream iss(line);
-            std::string rawname;
-            PlayerStats ps;
-            if (!(iss >> rawname >> ps.wins >> ps.losses >> ps.ties >> ps.best_streak >> ps.current_streak >> ps.biggest_win >> ps.total_games >> ps.blackjacks)) continue;
-            std::string rest;
-            if (std::getline(iss, rest)) {
-                size_t pos=0; while (pos<rest.size() && std::isspace((unsigned char)rest[pos])) ++pos;
-                if (pos<rest.size()) {
-                    ps.achievements = split_achievements(rest.substr(pos));
-                }
-            }
-            persistent_stats[unescape_name(rawname)] = ps;
-        }
+        if (shared_profiles) { for (auto &p : players) profiles[p.id] = shared_profiles->checkout(p.name); }
+        else if (config.persist) profiles.load(stats_filename);
     }
     void save_stats_to_file() {
-        std::ofstream out(stats_filename, std::ios::trunc);
-        if (!out) { std::cerr << "Warning: cannot save player stats\n"; return; }
-        for (auto &entry : persistent_stats) {
-            out << escape_name(entry.first) << " "
-                << entry.second.wins << " " << entry.second.losses << " " << entry.second.ties << " "
-                << entry.second.best_streak << " " << entry.second.current_streak << " "
-                << entry.second.biggest_win << " " << entry.second.total_games << " "
-                << entry.second.blackjacks;
-            if (!entry.second.achievements.empty()) out << " " << join_achievements(entry.second.achievements);
-            out << "\n";
-        }
-    }
-
-    // Name escaping helpers
-    static std::string escape_name(const std::string& name) {
-        std::string out; for (char c : name) out.push_back(c==' ' ? '_' : c); return out;
-    }
-    static std::string unescape_name(const std::string& name) {
-        std::string out; for (char c : name) out.push_back(c=='_' ? ' ' : c); return out;
+        if (shared_profiles) { for (auto &p : players) shared_profiles->checkin(p.name, profiles[p.id]); }
+        else if (config.persist) profiles.save(stats_filename);
     }
 
     // Achievements
-    void unlock_achievement_for(const std::string& player_name, const std::string& ach_key) {
-        auto it = persistent_stats.find(player_name);
-        if (it == persistent_stats.end()) return;
-        PlayerStats &ps = it->second;
-        if (ps.achievements.find(ach_key) == ps.achievements.end()) {
-            ps.achievements.insert(ach_key);
-            for (auto &p : players) if (p.name == player_name && p.is_human) {
-                std::cout << BOLD << GREEN << "\n>>> Achievement Unlocked: " << ach_key << "!\n    " << all_achievements.at(ach_key) << RESET << "\n";
-                break;
-            }
-            save_stats_to_file();
+    void bind_achievement_seats() {
+        achievements.resize_seats((int)players.size());
+        for (auto &p : players) achievements.mark_unlocked(p.seat, profiles[p.id].achievements);
+    }
+    // Records the unlock on the profile; the round-end save persists it
+    void unlock_achievement_for(const Player& p, const AchievementRule& rule) {
+        PlayerStats &ps = profiles[p.id];
+        if (!ps.achievements.insert(rule.key).second) return;
+        if (p.is_human) {
+            out << BOLD << GREEN << "\n>>> Achievement Unlocked: " << rule.key << "!\n    " << rule.description << RESET << "\n";
         }
     }
+    void fire_event(Player& p, EventContext ev) {
+        ev.seat = p.seat;
+        round_events.push_back(ev);
+    }
+    void evaluate_round_achievements() {
+        achievements.dispatch_batch(round_events, [&](int seat, int rule) {
+            if (Player *p = seat_players[seat]) unlock_achievement_for(*p, achievements.rule(rule));
+        });
+        round_events.clear();
+    }
+    void fire_event(Player& p, GameEvent type) {
+        EventContext ev; ev.type = type; ev[Field::Hand] = p.hand_value();
+        fire_event(p, ev);
+    }
 
     // Transactions logging
-    void push_transaction(int amount) { chip_transactions.push(amount); }
-    void sync_chip_map_from_players() { for (auto &p : players) chip_map[p.name] = p.chips; }
+    // Balances: every chip movement goes through move_chips so the ledger always matches
+    Chips chips_of(const Player& p) const { return balances[p.seat]; }
+    void move_chips(const Player& p, Chips amount, LedgerReason reason) {
+        balances[p.seat] += amount;
+        audit.on_balance_change(amount, balances[p.seat], current_round, p.seat);
+        ledger.record(current_round, p.id, amount, reason);
+        if (event_log) event_log->chips(reason, p.seat, amount);
+    }
+    void set_audit(bool on) { audit.enabled = on; }
+    // What the table rules owe each winner: 2x the bet, 2.5x on a blackjack, and an equal
+    // share of the pot for a winner who didn't bet (the remainder of the split stays with the house)
+    void audit_round(const SeatSet& winners, int winner_count) {
+        Chips due_total = 0;
+        if (pot > 0 && winner_count > 0) winners.for_each([&](int seat) {
+            Chips bet = seat_bets[seat];
+            Chips due = bet <= 0 ? pot / winner_count : is_blackjack(seat_players[seat]->hand) ? bet + (bet * 3) / 2 : bet * 2;
+            if (audit.enabled && seat_payouts[seat] != due)
+                audit.report(current_round, "seat " + std::to_string(seat) + " was paid " + std::to_string(seat_payouts[seat]) + ", due " + std::to_string(due));
+            due_total += due;
+        });
+        audit.on_settle(pot, due_total);
+        audit.check_round(current_round);
+        if (audit.full_recount_due())
+            audit.check_recount(current_round, std::accumulate(balances.begin(), balances.end(), Chips(0)));
+    }
+    // Name-keyed view of the seated players' balances, built on demand for display
+    std::map<std::string,Chips> chip_map() const {
+        std::map<std::string,Chips> view;
+        for (auto &p : players) view[p.name] = chips_of(p);
+        return view;
+    }
 
     void show_recent_transactions(int n=10) {
-        std::queue<int> copy = chip_transactions;
-        std::deque<int> tmp;
-        while (!copy.empty()) { tmp.push_back(copy.front()); copy.pop(); }
-        std::cout << "Recent transactions (oldest->newest): ";
-        int start = std::max(0, static_cast<int>(tmp.size()) - n);
-        for (int i = start; i < (int)tmp.size(); ++i) {
-            int v = tmp[i]; if (v>=0) std::cout << "+" << v; else std::cout << v;
-            if (i+1 < (int)tmp.size()) std::cout << ", ";
+        if (config.quiet) return;
+        out << "Recent transactions (oldest->newest): ";
+        std::size_t count = ledger.size();
+        std::size_t start = count > (std::size_t)n ? count - n : 0;
+        for (std::size_t i = start; i < count; ++i) {
+            const LedgerRecord &r = ledger.at(i);
+            out << profiles.name_of(r.player) << " ";
+            if (r.amount >= 0) out << "+";
+            out << r.amount;
+            if (r.reason == LedgerReason::Reset || r.reason == LedgerReason::Rebuy) out << " (" << LedgerReasonNames[static_cast<int>(r.reason)] << ")";
+            if (i+1 < count) out << ", ";
         }
-        std::cout << "\n";
+        out << "\n";
     }
 
     // -----------------------------
     // UI helpers
     // -----------------------------
     int speed_delay_ms() const {
+        if (config.quiet || !config.paced) return 0;
         if (text_speed <= 0) return 10;
         if (text_speed == 1) return 120;
         return 300;
     }
 
-    void print_round_header(int round) {
+    // -----------------------------
+    // Bot protocol: the human seat's requests and results as JSON lines
+    // -----------------------------
+    void hand_json(JsonLine& j, const char* key, const Player& p) const {
+        j.open(key, '[');
+        for (auto &c : p.hand) j.card(nullptr, c);
+        j.close(']');
+    }
+    void bot_bet(Chips chips, Chips default_bet) {
+        JsonLine("bet").num("round", current_round).num("chips", chips).num("default", default_bet)
+            .num("min", 1).num("max", chips).send(bot);
+    }
+    void bot_turn(const Player& p) {
+        JsonLine j("turn");
+        j.num("round", current_round).num("seat", p.seat);
+        hand_json(j, "hand", p);
+        j.num("value", p.hand_value()).num("chips", chips_of(p)).num("bet", seat_bets[p.seat]).num("pot", pot);
+        j.open("seats", '[');
+        for (auto &o : players) {
+            if (&o == &p) continue;
+            j.open(nullptr, '{').num("seat", o.seat).str("name", o.name).num("chips", chips_of(o))
+                .num("bet", seat_bets[o.seat]).num("cards", static_cast<std::int64_t>(o.hand.size()));
+            if (dealer_upcard_mode) { if (!o.hand.empty()) j.card("up", o.hand.front()); }
+            else { hand_json(j, "hand", o); j.num("value", o.hand_value()); }
+            j.flag("stood", o.stood).flag("busted", o.busted).close('}');
+        }
+        j.close(']');
+        j.open("actions", '[').str(nullptr, "h").str(nullptr, "s").str(nullptr, "d").str(nullptr, "q").close(']');
+        j.send(bot);
+    }
+    void bot_result(const SeatSet& winners) {
+        for (auto &p : players) {
+            if (!p.is_human) continue;
+            JsonLine j("result");
+            j.num("round", current_round);
+            hand_json(j, "hand", p);
+            j.num("value", p.hand_value()).str("outcome", p.busted ? "bust" : winners.test(p.seat) ? "win" : "loss")
+                .num("bet", seat_bets[p.seat]).num("payout", seat_payouts[p.seat]).num("chips", chips_of(p));
+            j.open("winners", '[');
+            winners.for_each([&](int seat) { j.num(nullptr, seat); });
+            j.close(']');
+            j.send(bot);
+        }
+    }
+
+    void bot_deal(std::int64_t next_round) {
+        JsonLine("deal").num("round", next_round).open("actions", '[').str(nullptr, "d").str(nullptr, "q").close(']').send(bot);
+    }
+    void bot_error(const char* message) { JsonLine("error").str("message", message).send(bot); }
+
+    // Bot protocol session on *input: a deal request before each round, one reply per request
+    void bot_loop() {
+        std::int64_t round = 0;
+        std::string line;
+        while (true) {
+            bot_deal(round + 1);
+            if (!std::getline(*input, line) || (!line.empty() && (line[0] == 'q' || line[0] == 'Q'))) break;
+            play_round(++round);
+            if (!finish_round() || !human_seated() || leaving()) break;
+        }
+        end_game();
+    }
+
+    void print_round_header(std::int64_t round) {
         std::ostringstream oss;
         oss << "================== ROUND " << round << " ==================";
         std::string s = oss.str();
-        std::cout << BCYAN << s << RESET << "\n";
+        out << BCYAN << s << RESET << "\n";
     }
-    void print_round_footer(int round) {
+    void print_round_footer(std::int64_t round) {
         std::ostringstream oss;
         oss << "============== END ROUND " << round << " ==============";
-        std::cout << BCYAN << oss.str() << RESET << "\n\n";
+        out << BCYAN << oss.str() << RESET << "\n\n";
     }
 
     // Colored scoreboard
+    // " 45% 20%    +30" for a window; blank until the seat has played a round
+    static std::string format_window(const RollingWindow& w) {
+        if (!w.filled) return "";
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(0) << std::right
+            << std::setw(4) << 100.0 * w.win_rate() << "%" << std::setw(4) << 100.0 * w.bust_rate() << "%"
+            << std::showpos << std::setw(7) << w.net;
+        return oss.str();
+    }
+    void show_rolling_windows() {
+        out << "\n--- Rolling windows (win rate, bust rate, net chips) ---\n";
+        for (auto &p : players) {
+            out << std::left << std::setw(20) << p.name << std::right;
+            for (auto &w : windows[p.seat].w)
+                out << "  last " << std::setw(4) << w.capacity() << " (n=" << std::setw(4) << w.filled << "):" << format_window(w);
+            out << "\n";
+        }
+    }
+
     void show_scoreboard_colored() {
-        const int width = 63;
-        std::cout << BOLD << MAGENTA;
-        for (int i=0;i<width;++i) std::cout << "-";
-        std::cout << "\n";
-        std::cout << std::left << std::setw(20) << "PLAYER"
-                  << std::setw(8) << "CHIPS"
-                  << std::setw(10) << "RESULT"
-                  << std::setw(25) << "HAND"
-                  << "\n";
-        for (int i=0;i<width;++i) std::cout << "-";
-        std::cout << RESET << "\n";
+        if (config.quiet) return;
+        const int width = 92;
+        out << BOLD << MAGENTA;
+        for (int i=0;i<width;++i) out << "-";
+        out << "\n";
+        out << std::left << std::setw(20) << "PLAYER"
+            << std::setw(8) << "CHIPS"
+            << std::setw(10) << "RESULT"
+            << std::setw(25) << "HAND"
+            << std::right << std::setw(5) << "WIN" << std::setw(5) << "BUST" << std::setw(7) << "NET"
+            << " (last " << kRollingWindowSizes[0] << ")" << std::left
+            << "\n";
+        for (int i=0;i<width;++i) out << "-";
+        out << RESET << "\n";
 
         for (auto &p : players) {
             // Name color
@@ -549,14 +2275,15 @@ public:
             else if (p.stood) status = "STOOD";
             else status = "PLAY";
 
-            std::string chip_color = (p.chips >= 200 ? BGREEN : (p.chips >= 100 ? GREEN : (p.chips >= 40 ? YELLOW : RED)));
+            Chips chips = chips_of(p);
+            std::string chip_color = (chips >= 200 ? BGREEN : (chips >= 100 ? GREEN : (chips >= 40 ? YELLOW : RED)));
 
-            std::cout << name_color << std::left << std::setw(20) << p.name << RESET;
-            std::cout << chip_color << std::setw(8) << p.chips << RESET;
+            out << name_color << std::left << std::setw(20) << p.name << RESET;
+            out << chip_color << std::setw(8) << chips << RESET;
             // result color
-            if (p.busted) std::cout << BRED << std::setw(10) << status << RESET;
-            else if (p.hand_value() == 21) std::cout << BGREEN << std::setw(10) << "21" << RESET;
-            else std::cout << BCYAN << std::setw(10) << status << RESET;
+            if (p.busted) out << BRED << std::setw(10) << status << RESET;
+            else if (p.hand_value() == 21) out << BGREEN << std::setw(10) << "21" << RESET;
+            else out << BCYAN << std::setw(10) << status << RESET;
 
             std::ostringstream hands;
             if (p.hand.empty()) hands << "(no cards)";
@@ -571,12 +2298,13 @@ public:
                 hands << ")";
             }
 
-            std::cout << std::setw(25) << hands.str() << "\n";
+            out << std::setw(25) << hands.str();
+            out << format_window(windows[p.seat].w[0]) << "\n";
         }
 
-        std::cout << BOLD << MAGENTA;
-        for (int i=0;i<width;++i) std::cout << "-";
-        std::cout << RESET << "\n";
+        out << BOLD << MAGENTA;
+        for (int i=0;i<width;++i) out << "-";
+        out << RESET << "\n";
     }
 
     // NPC speech bubble printer
@@ -585,100 +2313,111 @@ public:
         std::string line = npc.speech.front();
         // Rotate speech
         // Top-level rotation is performed elsewhere if needed
-        std::cout << BYELLOW << npc.name << ": " << RESET << line << "\n";
+        out << BYELLOW << npc.name << ": " << RESET << line << "\n";
     }
 
     // -----------------------------
     // Round prep / dealing
     // -----------------------------
     void prepare_round() {
-        betting_pot.clear();
+        std::fill(seat_bets.begin(), seat_bets.end(), 0);
+        std::fill(seat_payouts.begin(), seat_payouts.end(), 0);
+        pot = 0;
+        round_events.clear();
+        round_events.reserve(players.size() * 4);
         for (auto &p : players) p.clear_hand();
         if (deck.size() < 15) { deck.build_new_deck(); deck.shuffle_deck(); }
-        while (!turn_queue.empty()) turn_queue.pop();
-        for (auto &p : players) if (p.chips > 0) turn_queue.push(p.name);
+        round_shoe_pos = static_cast<int>(deck.size());
+        round_true_count = deck.true_count();
         for (auto &p : players) if (p.is_human) dealer.say_good_luck();
     }
 
-    void collect_bets() {
+    Task collect_bets() {
         for (auto it = players.begin(); it != players.end(); ++it) {
             Player &p = *it;
-            if (p.chips <= 0) continue;
-            int bet = 0;
+            const Chips chips = chips_of(p);
+            if (chips <= 0) continue;
+            Chips bet = 0;
             if (p.is_human) {
                 // offer last bet as default
-                int default_bet = (p.last_bet > 0 ? p.last_bet : bet_amount);
-                std::cout << BOLD << "You have " << p.chips << " chips. Press ENTER to bet " << default_bet
-                          << " or type an amount (1-" << p.chips << "): " << RESET;
-                std::string line;
-                if (std::cin.rdbuf()->in_avail() > 0) {
+                Chips default_bet = (p.last_bet > 0 ? p.last_bet : bet_amount);
+                out << BOLD << "You have " << chips << " chips. Press ENTER to bet " << default_bet
+                    << " or type an amount (1-" << chips << "): " << RESET;
+                if (!bot && !config.remote && std::cin.rdbuf()->in_avail() > 0) {
                     // flush leftover newline
-                    std::getline(std::cin, line);
-                }
-                std::getline(std::cin, line);
-                if (line.empty()) { bet = std::min(p.chips, default_bet); }
-                else {
-                    try {
-                        int parsed = std::stoi(line);
-                        if (parsed < 1) parsed = 1;
-                        if (parsed > p.chips) parsed = p.chips;
-                        bet = parsed;
-                    } catch(...) { std::cout << "Invalid input, using default.\n"; bet = std::min(p.chips, default_bet); }
+                    co_await next_line();
+                }
+                // A bot gets an error and the request again, as for an unknown action
+                for (bool answered = false; !answered;) {
+                    if (bot) bot_bet(chips, default_bet);
+                    std::string line = (co_await next_line()).value_or("");
+                    answered = true;
+                    if (line.empty()) { bet = std::min(chips, default_bet); }
+                    else {
+                        try {
+                            Chips parsed = std::stoll(line);
+                            if (parsed < 1) parsed = 1;
+                            if (parsed > chips) parsed = chips;
+                            bet = parsed;
+                        } catch(...) {
+                            if (bot) { bot_error("invalid bet"); answered = false; }
+                            else { out << "Invalid input, using default.\n"; bet = std::min(chips, default_bet); }
+                        }
+                    }
                 }
                 p.last_bet = bet;
             } else {
                 // NPCs: personality-based betting
                 std::uniform_int_distribution<int> dist(0,99);
                 int roll = dist(rng);
-                int extra = 0;
-                // Find personality by name
-                if (p.name.find("Cautious") != std::string::npos) {
+                Chips extra = 0;
+                if (p.personality == Personality::Cautious) {
                     // Rarely raises
-                    if (roll > 90 && p.chips > bet_amount) extra = bet_amount/2;
-                } else if (p.name.find("Reckless") != std::string::npos) {
+                    if (roll > 90 && chips > bet_amount) extra = bet_amount/2;
+                } else if (p.personality == Personality::Reckless) {
                     // Frequently over-bets
-                    if (roll > 40 && p.chips > bet_amount) extra = bet_amount;
-                } else if (p.name.find("Smart") != std::string::npos) {
+                    if (roll > 40 && chips > bet_amount) extra = bet_amount;
+                } else if (p.personality == Personality::Smart) {
                     // Vary by streaks
-                    PlayerStats &ps = persistent_stats[p.name];
-                    if (ps.current_streak > 1 && p.chips > bet_amount) extra = bet_amount/2;
-                    if (roll > 95 && p.chips > bet_amount*2) extra = bet_amount*2;
-                } else if (p.name.find("Chaotic") != std::string::npos) {
+                    PlayerStats &ps = profiles[p.id];
+                    if (ps.current_streak > 1 && chips > bet_amount) extra = bet_amount/2;
+                    if (roll > 95 && chips > bet_amount*2) extra = bet_amount*2;
+                } else if (p.personality == Personality::Chaotic) {
                     // Random
                     if (roll % 2 == 0) extra = roll % (bet_amount+1);
                 }
-                bet = std::min(p.chips, bet_amount + extra);
-                if (roll < 6 && p.chips >= 1) bet = std::max(1, bet_amount / 2);
+                bet = std::min(chips, bet_amount + extra);
+                if (roll < 6 && chips >= 1) bet = std::min(chips, std::max<Chips>(1, bet_amount / 2));
                 p.last_bet = bet;
             }
-            p.chips -= bet;
+            move_chips(p, -bet, LedgerReason::Bet);
             p.wager_history.push_back(bet);
-            betting_pot.emplace_back(p.name, bet);
-            chip_map[p.name] = p.chips;
-            push_transaction(-bet);
+            seat_bets[p.seat] += bet;
+            pot += bet;
             // print spaced
-            std::cout << std::setw(16) << p.name << " bets " << bet << " chips.\n";
+            out << std::setw(16) << p.name << " bets " << bet << " chips.\n";
             sleep_ms(speed_delay_ms());
         }
-        std::cout << "\n";
+        out << "\n";
     }
 
     void initial_deal_animated() {
         int passes = 2;
         for (int pass=0; pass < passes; ++pass) {
             for (auto it = players.begin(); it != players.end(); ++it) {
-                if (it->chips < 0) continue;
+                if (chips_of(*it) < 0) continue;
                 Card c = deck.deal_one();
                 it->receive_card(c);
+                if (event_log) event_log->card(LogEvent::Deal, it->seat, c);
                 // animate output for human and show small reveal for NPCs
                 if (it->is_human) {
-                    std::cout << BGREEN << "Dealt to You: " << RESET << c.toString() << "\n";
+                    out << BGREEN << "Dealt to You: " << RESET << c.toString() << "\n";
                 } else {
                     if (dealer_upcard_mode && pass==0) {
                         // show only first card as upcard for NPCs
-                        std::cout << BYELLOW << it->name << RESET << " receives upcard: " << c.shortString() << "\n";
+                        out << BYELLOW << it->name << RESET << " receives upcard: " << c.shortString() << "\n";
                     } else {
-                        std::cout << BYELLOW << it->name << RESET << " receives: " << c.toString() << "\n";
+                        out << BYELLOW << it->name << RESET << " receives: " << c.toString() << "\n";
                     }
                 }
                 sleep_ms(speed_delay_ms());
@@ -687,40 +2426,43 @@ public:
     }
 
     void show_table(bool reveal_all=false) {
-        std::cout << "\n------- TABLE -------\n";
+        if (config.quiet) return;
+        out << "\n------- TABLE -------\n";
         for (auto &p : players) {
-            std::cout << p.name << " | chips: " << p.chips << " | hand: ";
+            out << p.name << " | chips: " << chips_of(p) << " | hand: ";
             if (p.is_human || reveal_all) {
-                std::cout << p.hand_to_string() << " (value: " << p.hand_value() << ")";
+                out << p.hand_to_string() << " (value: " << p.hand_value() << ")";
             } else {
-                if (p.hand.empty()) std::cout << "(no cards)";
+                if (p.hand.empty()) out << "(no cards)";
                 else {
                     // show only first card if dealer_upcard_mode
                     if (dealer_upcard_mode) {
                         auto cit = p.hand.cbegin();
-                        std::cout << cit->toString();
+                        out << cit->toString();
                         if ((++cit) != p.hand.cend()) {
-                            std::cout << ", [hidden]";
+                            out << ", [hidden]";
                         }
-                        std::cout << " (value: ???)";
+                        out << " (value: ???)";
                     } else {
                         auto cit = p.hand.cbegin();
-                        std::cout << "[hidden], "; ++cit;
+                        out << "[hidden], "; ++cit;
                         bool first = true;
                         for (; cit != p.hand.cend(); ++cit) {
-                            if (!first) std::cout << ", ";
-                            std::cout << cit->toString();
+                            if (!first) out << ", ";
+                            out << cit->toString();
                             first = false;
                         }
-                        std::cout << " (value: ???)";
+                        out << " (value: ???)";
                     }
                 }
             }
-            std::cout << "\n";
+            out << "\n";
         }
-        std::cout << "---------------------\n\n";
+        out << "---------------------\n\n";
     }
 
+    int speech_roll() { std::uniform_int_distribution<int> d(0,99); return d(rng); }
+
     // NPC automated turn with speech
     void npc_turn(Player& npc) {
         if (npc.busted || npc.stood) return;
@@ -728,30 +2470,35 @@ public:
         while (!npc.stood && !npc.busted) {
             int hv = npc.hand_value();
             bool should_hit = false;
-            if (npc.name.find("Cautious") != std::string::npos) should_hit = cautious_carl_should_hit(npc);
-            else if (npc.name.find("Reckless") != std::string::npos) should_hit = reckless_randy_should_hit(npc);
-            else if (npc.name.find("Smart") != std::string::npos) should_hit = smart_samantha_should_hit(npc, players);
-            else if (npc.name.find("Chaotic") != std::string::npos) should_hit = chaotic_chad_should_hit(npc, rng);
-            else should_hit = (hv < 16);
+            switch (npc.personality) {
+                case Personality::Cautious: should_hit = cautious_carl_should_hit(npc); break;
+                case Personality::Reckless: should_hit = reckless_randy_should_hit(npc); break;
+                case Personality::Smart: should_hit = smart_samantha_should_hit(npc, players); break;
+                case Personality::Chaotic: should_hit = chaotic_chad_should_hit(npc, rng); break;
+                default: should_hit = (hv < 16); break;
+            }
 
             if (should_hit) {
                 // announce speech sometimes
-                if (!npc.speech.empty() && (rand() % 100) < 40) {
-                    std::cout << BYELLOW << npc.name << ": " << RESET << npc.speech.front() << "\n";
+                if (!npc.speech.empty() && speech_roll() < 40) {
+                    out << BYELLOW << npc.name << ": " << RESET << npc.speech.front() << "\n";
                     std::rotate(npc.speech.begin(), npc.speech.begin()+1, npc.speech.end());
                 }
                 Card c = deck.deal_one();
                 npc.receive_card(c);
-                std::cout << BYELLOW << npc.name << RESET << " draws: " << c.toString() << " -> value=" << npc.hand_value() << "\n";
+                if (event_log) event_log->card(LogEvent::Hit, npc.seat, c);
+                out << BYELLOW << npc.name << RESET << " draws: " << c.toString() << " -> value=" << npc.hand_value() << "\n";
                 sleep_ms(speed_delay_ms());
-                if (npc.hand_value() > 21) { npc.busted = true; npc.active = false; break; }
+                if (npc.hand_value() > 21) { npc.busted = true; npc.active = false; fire_event(npc, GameEvent::Bust); break; }
             } else {
                 npc.stood = true; npc.active = false;
-                if (!npc.speech.empty() && (rand() % 100) < 60) {
-                    std::cout << BYELLOW << npc.name << ": " << RESET << npc.speech.front() << "\n";
+                if (event_log) event_log->stand(npc.seat);
+                if (!npc.speech.empty() && speech_roll() < 60) {
+                    out << BYELLOW << npc.name << ": " << RESET << npc.speech.front() << "\n";
                     std::rotate(npc.speech.begin(), npc.speech.begin()+1, npc.speech.end());
                 }
-                std::cout << BYELLOW << npc.name << RESET << " stands at " << npc.hand_value() << "\n";
+                out << BYELLOW << npc.name << RESET << " stands at " << npc.hand_value() << "\n";
+                fire_event(npc, GameEvent::Stand);
                 sleep_ms(speed_delay_ms());
                 break;
             }
@@ -759,92 +2506,126 @@ public:
     }
 
     // human turn with help menu '?'
-    void human_turn(Player& p) {
+    Task human_turn(Player& p) {
         while (!p.stood && !p.busted) {
-            std::cout << "\nYour hand: " << p.hand_to_string() << " (value: " << p.hand_value() << ")\n";
+            out << "\nYour hand: " << p.hand_to_string() << " (value: " << p.hand_value() << ")\n";
             if (p.hand_value() >= 17 && p.hand_value() < 21) dealer.say_encouragement();
-            std::cout << "Choose action: (h)it, (s)tand, (d)iscard, (v)iew profiles, (q)uit, (?)help: ";
-            std::string in;
-            std::getline(std::cin, in);
-            if (in.empty()) { std::getline(std::cin, in); } // safety to ensure we have input
+            out << "Choose action: (h)it, (s)tand, (d)iscard, (v)iew profiles, (q)uit, (?)help: ";
+            if (bot) bot_turn(p);
+            auto line = co_await next_line();
+            if (line && line->empty()) line = co_await next_line(); // safety to ensure we have input
+            std::string in = line ? *line : "s";   // input is gone (end of file, or a remote seat left or timed out)
             char c = in.empty() ? '\0' : in[0];
             if (c == 'h') {
                 Card card = deck.deal_one();
-                std::cout << BGREEN << "You drew: " << RESET << card.toString() << "\n";
+                out << BGREEN << "You drew: " << RESET << card.toString() << "\n";
                 p.receive_card(card);
+                if (event_log) event_log->card(LogEvent::Hit, p.seat, card);
                 if (p.hand_value() > 21) {
                     p.busted = true; p.active = false;
-                    std::cout << BRED << "You busted with " << p.hand_value() << "!" << RESET << "\n";
-                    if (p.hand_value() >= 22) unlock_achievement_for(p.name, "IT_HAPPENS");
+                    out << BRED << "You busted with " << p.hand_value() << "!" << RESET << "\n";
+                    fire_event(p, GameEvent::Bust);
                 }
             } else if (c == 's') {
                 int before = p.hand_value(); p.stood = true; p.active = false;
-                std::cout << "You chose to stand at " << before << ".\n";
+                if (event_log) event_log->stand(p.seat);
+                out << "You chose to stand at " << before << ".\n";
+                fire_event(p, GameEvent::Stand);
             } else if (c == 'd') {
                 if (!p.hand.empty()) {
                     Card top = p.hand.back();
                     p.hand.pop_back();
                     deck.discard_card(top);
-                    std::cout << "Discarded " << top.toString() << " to discard pile.\n";
-                } else std::cout << "Hand empty, cannot discard.\n";
-            } else if (c == 'v') display_profiles_menu();
-            else if (c == 'q') { std::cout << "Quitting...\n"; save_stats_to_file(); exit(0); }
-            else if (c == '?') {
-                std::cout << "\nActions:\n  h = hit\n  s = stand\n  d = discard card (remove last)\n  v = view profiles\n  q = quit\n  ? = help\n";
+                    if (event_log) event_log->card(LogEvent::Discard, p.seat, top);
+                    out << "Discarded " << top.toString() << " to discard pile.\n";
+                } else out << "Hand empty, cannot discard.\n";
+            } else if (c == 'v' && !bot) co_await display_profiles_menu();
+            else if (c == 'q' && (config.remote || bot)) {
+                // A remote seat can't end the process: stand, and leave once the round is over
+                out << "You stand and will leave after this round.\n";
+                p.stood = true; p.active = false; human_leaving = true;
+                if (event_log) event_log->stand(p.seat);
+            }
+            else if (c == 'q') {
+                out << "Quitting...\n"; save_stats_to_file(); ledger.flush();
+                if (history) history->flush();
+                if (event_log) event_log->close();
+                exit(0);
+            }
+            else if (c == '?' && !bot) {
+                out << "\nActions:\n  h = hit\n  s = stand\n  d = discard card (remove last)\n  v = view profiles\n  q = quit\n  ? = help\n";
             } else {
-                std::cout << "Unknown option. Type ? for help.\n";
+                out << "Unknown option. Type ? for help.\n";
+                if (bot) bot_error("unknown action");
             }
             // small pause
             sleep_ms(speed_delay_ms());
         }
     }
 
-    // compute pot total
-    int pot_total() const {
-        int tot = 0;
-        for (auto &e : betting_pot) tot += e.second;
-        return tot;
-    }
+    // pot total, kept up to date by collect_bets
+    Chips pot_total() const { return pot; }
 
     // payout logic
-    void resolve_payouts_and_update_stats(const std::list<std::reference_wrapper<Player>>& winners) {
-        int total_pot = pot_total();
+    void resolve_payouts_and_update_stats(const SeatSet& winners, int winner_count) {
+        Chips total_pot = pot_total();
         if (total_pot <= 0) return;
-        if (winners.empty()) return;
-        std::map<std::string,int> bet_by_player;
-        for (auto &entry : betting_pot) bet_by_player[entry.first] += entry.second;
-
-        for (auto ref : winners) {
-            Player &winp = ref.get();
-            int player_bet = bet_by_player[winp.name];
-            int payout = 0;
-            if (player_bet <= 0) payout = total_pot / (int)winners.size();
+        if (winner_count == 0) return;
+
+        winners.for_each([&](int seat) {
+            Player &winp = *seat_players[seat];
+            Chips player_bet = seat_bets[winp.seat];
+            Chips payout = 0;
+            if (player_bet <= 0) payout = total_pot / winner_count;
             else {
                 if (is_blackjack(winp.hand)) payout = player_bet + (player_bet * 3) / 2;
                 else payout = player_bet * 2;
             }
-            winp.chips += payout;
-            chip_map[winp.name] = winp.chips;
-            push_transaction(+payout);
-            std::cout << BGREEN << winp.name << RESET << " receives payout: " << payout << " chips.\n";
+            move_chips(winp, +payout, LedgerReason::Payout);
+            seat_payouts[seat] += payout;
+            out << BGREEN << winp.name << RESET << " receives payout: " << payout << " chips.\n";
+            EventContext ev; ev.type = GameEvent::Payout; ev[Field::Payout] = payout; ev[Field::Hand] = winp.hand_value(); ev[Field::Chips] = chips_of(winp);
+            fire_event(winp, ev);
             sleep_ms(speed_delay_ms());
-        }
+        });
     }
 
     // play a round
-    void play_round(int round_num) {
+    void play_round(std::int64_t round_num) { run_blocking(play_round_task(round_num)); }
+
+    // Asynchronous rounds: begin_round runs until the human seat is asked for input or the round
+    // is over, and each provide_input answers the outstanding request and runs on to the next one.
+    void begin_round(std::int64_t round_num) {
+        round_task = play_round_task(round_num);
+        round_task.resume();
+    }
+    bool round_pending() const { return static_cast<bool>(round_task); }
+    bool awaiting_input() const { return static_cast<bool>(input_waiter); }
+    void provide_input(std::optional<std::string> line) {
+        input_line = std::move(line);
+        std::exchange(input_waiter, {}).resume();
+    }
+    // Once the round has run to completion: rethrows anything it threw
+    void end_round() { Task done = std::move(round_task); done.result(); }
+
+    Task play_round_task(std::int64_t round_num) {
+        current_round = round_num;
+        if (event_log) {
+            if (event_log->needs_header()) event_log->write_header(event_log_header());
+            event_log->round_start(round_num);
+        }
         print_round_header(round_num);
         prepare_round();
-        collect_bets();
+        co_await collect_bets();
         initial_deal_animated();
 
         // detect blackjacks
         for (auto &p : players) {
-            if (p.chips < 0) continue;
+            if (chips_of(p) < 0) continue;
             if (is_blackjack(p.hand)) {
                 p.stood = true; p.active = false;
-                stats_blackjacks[p.name]++; persistent_stats[p.name].blackjacks++;
-                if (p.is_human) unlock_achievement_for(p.name,"BLACKJACK");
+                session[p.id].blackjacks++; profiles[p.id].blackjacks++;
+                fire_event(p, GameEvent::Blackjack);
             }
         }
 
@@ -854,252 +2635,1953 @@ public:
         // action loop
         for (auto it = players.begin(); it != players.end(); ++it) {
             Player &p = *it;
-            if (p.chips < 0) continue;
+            if (chips_of(p) < 0) continue;
             if (p.is_human) {
-                if (!(p.stood || p.busted)) human_turn(p);
+                if (!(p.stood || p.busted)) co_await human_turn(p);
             } else {
                 if (!(p.stood || p.busted)) npc_turn(p);
             }
         }
 
-        // evaluate winners
-        int best_value = 0;
+        // evaluate winners: one pass yields the best value, the winners set and the runner-up value
+        int best_value = -1, second_value = 0, winner_count = 0;
+        SeatSet winners;
         for (auto &p : players) {
             if (p.busted) continue;
             int hv = p.hand_value();
-            if (hv > best_value && hv <= 21) best_value = hv;
-        }
-        std::list<std::reference_wrapper<Player>> winners;
-        for (auto &p : players) {
-            if (p.busted) continue;
-            if (p.hand_value() == best_value) winners.push_back(std::ref(p));
+            if (hv > best_value) {
+                if (best_value > second_value) second_value = best_value;
+                best_value = hv; winners.clear(); winners.set(p.seat); winner_count = 1;
+            } else if (hv == best_value) {
+                winners.set(p.seat); ++winner_count;
+            } else if (hv > second_value) second_value = hv;
         }
 
         // update stats
-        if (winners.empty()) {
-            std::cout << BYELLOW << "Everyone busted. House keeps the pot.\n" << RESET;
-            for (auto &p : players) {
-                if (p.chips >= 0) { stats_losses[p.name]++; persistent_stats[p.name].losses++; persistent_stats[p.name].current_streak = 0; persistent_stats[p.name].total_games++; }
-            }
-            for (auto &p : players) if (p.is_human) dealer.say_snarky();
+        bool human_won = false;
+        if (winner_count == 0) {
+            out << BYELLOW << "Everyone busted. House keeps the pot.\n" << RESET;
         } else {
-            for (auto ref : winners) {
-                Player &winp = ref.get();
-                stats_wins[winp.name]++; persistent_stats[winp.name].wins++; persistent_stats[winp.name].current_streak++; persistent_stats[winp.name].total_games++;
-                if (persistent_stats[winp.name].current_streak > persistent_stats[winp.name].best_streak) persistent_stats[winp.name].best_streak = persistent_stats[winp.name].current_streak;
-                if (is_blackjack(winp.hand)) { stats_blackjacks[winp.name]++; persistent_stats[winp.name].blackjacks++; }
-            }
-            resolve_payouts_and_update_stats(winners);
-
-            bool human_won = false;
-            for (auto ref : winners) if (ref.get().is_human) human_won = true;
-
-            if (human_won) {
-                std::queue<int> copy = chip_transactions;
-                while (!copy.empty()) { int v = copy.front(); copy.pop(); if (v >= 40) { unlock_achievement_for("You","HIGH_ROLLER"); break; } }
-                if (persistent_stats["You"].wins >= 10) unlock_achievement_for("You","CARD_SHARK");
-                if (persistent_stats["You"].current_streak >= 3) unlock_achievement_for("You","HOT_STREAK");
-                int human_post_chips = 0; for (auto &p: players) if (p.is_human) human_post_chips = p.chips;
-                if (human_post_chips >= 200) unlock_achievement_for("You","SURVIVOR");
-                if (human_post_chips >= 300) unlock_achievement_for("You","UNSTOPPABLE");
-                bool opponent_had_20_or_21=false; for (auto &p: players) if (!p.is_human) { int hv = p.hand_value(); if (hv==20||hv==21) opponent_had_20_or_21=true; }
-                if (opponent_had_20_or_21) unlock_achievement_for("You","AGAINST_ODDS");
-            } else {
-                for (auto &p : players) if (p.is_human) {
-                    if (p.stood && p.hand_value() == 20) unlock_achievement_for(p.name,"CLOSE_CALL");
-                }
-                for (auto &p : players) if (p.is_human) dealer.say_snarky();
+            winners.for_each([&](int seat) {
+                Player &winp = *seat_players[seat];
+                PlayerStats &ps = profiles[winp.id];
+                session[winp.id].wins++; ps.wins++; ps.current_streak++; ps.total_games++;
+                if (ps.current_streak > ps.best_streak) ps.best_streak = ps.current_streak;
+                if (is_blackjack(winp.hand)) { session[winp.id].blackjacks++; ps.blackjacks++; }
+                if (winp.is_human) human_won = true;
+            });
+            resolve_payouts_and_update_stats(winners, winner_count);
+        }
+        for (auto &p : players) {
+            if (winners.test(p.seat) || chips_of(p) < 0) continue;
+            PlayerStats &ps = profiles[p.id]; session[p.id].losses++; ps.losses++; ps.total_games++;
+            if (ps.current_streak > 0) {
+                ev.seat_hists[p.seat].streak.add(ps.current_streak);
+                ev.personality_hists[static_cast<int>(p.personality)].streak.add(ps.current_streak);
             }
+            ps.current_streak = 0;
+        }
+        if (!human_won) for (auto &p : players) if (p.is_human) dealer.say_snarky();
 
-            for (auto &p : players) {
-                bool is_winner=false;
-                for (auto ref : winners) if (ref.get().name==p.name) { is_winner=true; break; }
-                if (!is_winner) { stats_losses[p.name]++; persistent_stats[p.name].losses++; persistent_stats[p.name].current_streak=0; persistent_stats[p.name].total_games++; }
-            }
+        // Post-round achievements: one RoundEnd event per seat.
+        // A seat's best opponent is the runner-up value only when it is the sole winner.
+        for (auto &p : players) {
+            const PlayerStats &ps = profiles[p.id];
+            EventContext ev;
+            ev.type = GameEvent::RoundEnd;
+            int hv = p.hand_value();
+            bool won = winners.test(p.seat);
+            ev[Field::Hand] = hv;
+            ev[Field::Chips] = chips_of(p);
+            ev[Field::Streak] = ps.current_streak;
+            ev[Field::Wins] = ps.wins;
+            ev[Field::Games] = ps.total_games;
+            ev[Field::Won] = won;
+            ev[Field::Stood] = p.stood;
+            ev[Field::OppBest] = (won && winner_count == 1) ? second_value : std::max(best_value, 0);
+            fire_event(p, ev);
+        }
+        evaluate_round_achievements();
+
+        record_round_stats(winners);
+        if (bot) bot_result(winners);
+        show_round_results();
+
+        audit_round(winners, winner_count);
+        if (event_log) event_log->round_end(state_digest());
+        save_stats_to_file();
+        show_scoreboard_colored();
+        print_round_footer(round_num);
+    }
+
+    // EV, outcome histograms and rolling windows: hands for every seat dealt in, money for every seat that bet
+    void record_round_stats(const SeatSet& winners) {
+        for (auto &p : players) {
+            if (p.hand.empty()) continue;
+            int pi = static_cast<int>(p.personality);
+            int hv = p.hand_value();
+            OutcomeHistograms &sh = ev.seat_hists[p.seat], &ph = ev.personality_hists[pi];
+            sh.hand.add(hv); ph.hand.add(hv);
+            if (p.busted) { sh.bust.add(hv - 22); ph.bust.add(hv - 22); }
+            windows[p.seat].push(winners.test(p.seat), p.busted, seat_payouts[p.seat] - seat_bets[p.seat]);
+            if (history) record_hand(p, winners);
+            Chips bet = seat_bets[p.seat];
+            if (bet <= 0) continue;
+            Chips payout = seat_payouts[p.seat];
+            ev.seats[p.seat].add(bet, payout);
+            ev.personalities[pi].add(bet, payout);
+            sh.payout.add(payout_bucket(payout)); ph.payout.add(payout_bucket(payout));
+        }
+    }
+    void record_hand(const Player& p, const SeatSet& winners) {
+        HandRow row;
+        row.round = current_round;
+        row.seat = p.seat;
+        row.personality = p.personality;
+        std::list<Card> first_two(p.hand.begin(), std::next(p.hand.begin(), std::min<std::size_t>(2, p.hand.size())));
+        row.start_value = compute_hand_value(first_two);
+        row.upcard = get_visible_highest_card_value(players, p.name);
+        row.cards.reserve(p.hand.size());
+        for (auto &c : p.hand) row.cards.push_back(c.to_byte());
+        row.decisions = static_cast<std::uint8_t>(std::min<std::size_t>(p.hand.size() - first_two.size(), 0x3F) | (p.stood ? kDecisionStood : 0));
+        row.final_value = p.hand_value();
+        row.bet = seat_bets[p.seat];
+        row.payout = seat_payouts[p.seat];
+        row.shoe_pos = round_shoe_pos;
+        row.true_count = round_true_count;
+        row.outcome = p.busted ? HandOutcome::Bust : winners.test(p.seat) ? HandOutcome::Win : HandOutcome::Loss;
+        history->append(row);
+    }
+    void set_history(HandHistoryWriter* w) { history = w; }
+    void set_event_log(EventLogWriter* w) { event_log = w; }
+    void show_histograms() {
+        out << "\n--- Outcome histograms (this session) ---\n";
+        for (auto &p : players) dump_outcome_histograms(out, p.name, ev.seat_hists[p.seat]);
+    }
+    const StatsShard& ev_stats() const { return ev; }
+
+    // Checkpoint of everything a quiet table carries between rounds: rng streams, shoe,
+    // balances, per-seat profile and session counters, rolling windows, the audit and the EV shard.
+    // Only valid between rounds; the ledger ring is not saved (it is a display cache).
+    void save_state(std::ostream& os) const {
+        os << std::setprecision(17) << current_round << '\n' << rng << '\n';
+        deck.save_state(os);
+        os << players.size() << '\n';
+        for (auto &p : players) {
+            const PlayerStats &ps = profiles[p.id];
+            const SessionStats &ss = session[p.id];
+            os << p.seat << ' ' << balances[p.seat] << ' ' << p.last_bet << '\n';
+            for (Chips w : p.wager_history.recent) os << w << ' ';
+            write_state(os, p.wager_history.all);
+            os << ps.wins << ' ' << ps.losses << ' ' << ps.ties << ' ' << ps.best_streak << ' ' << ps.current_streak << ' '
+               << ps.biggest_win << ' ' << ps.total_games << ' ' << ps.blackjacks << ' '
+               << (ps.achievements.empty() ? "-" : join_achievements(ps.achievements)) << '\n';
+            os << ss.wins << ' ' << ss.losses << ' ' << ss.ties << ' ' << ss.blackjacks << '\n';
+            for (auto &w : windows[p.seat].w) write_state(os, w);
         }
+        os << audit.seat_total << ' ' << audit.house_take << ' ' << audit.minted << ' ' << audit.baseline << ' '
+           << audit.rounds_checked << ' ' << audit.violations << '\n';
+        write_state(os, ev);
+    }
+    // Restores a save_state snapshot taken from a table with the same seating
+    void load_state(std::istream& is) {
+        std::size_t seats = 0;
+        is >> current_round >> rng;
+        deck.load_state(is);
+        if (!(is >> seats) || seats != players.size()) throw std::runtime_error("checkpoint seating does not match the table");
+        for (auto &p : players) {
+            PlayerStats &ps = profiles[p.id];
+            SessionStats &ss = session[p.id];
+            int seat = -1;
+            std::string ach;
+            is >> seat >> balances[p.seat] >> p.last_bet;
+            if (seat != p.seat) throw std::runtime_error("checkpoint seat order does not match the table");
+            for (Chips &w : p.wager_history.recent) is >> w;
+            read_state(is, p.wager_history.all);
+            is >> ps.wins >> ps.losses >> ps.ties >> ps.best_streak >> ps.current_streak >> ps.biggest_win >> ps.total_games >> ps.blackjacks >> ach;
+            ps.achievements = ach == "-" ? std::set<std::string>() : split_achievements(ach);
+            is >> ss.wins >> ss.losses >> ss.ties >> ss.blackjacks;
+            for (auto &w : windows[p.seat].w) read_state(is, w);
+        }
+        is >> audit.seat_total >> audit.house_take >> audit.minted >> audit.baseline >> audit.rounds_checked >> audit.violations;
+        read_state(is, ev);
+        if (!is) throw std::runtime_error("truncated or corrupt checkpoint");
+        bind_achievement_seats();
+    }
+
+    // FNV-1a over the state that decides later rounds: balances, hands, streaks and the shoe
+    std::uint32_t state_digest() const {
+        std::uint32_t h = 2166136261u;
+        auto mix = [&h](std::int64_t v) {
+            for (int i = 0; i < 8; ++i) { h ^= static_cast<std::uint8_t>(static_cast<std::uint64_t>(v) >> (8 * i)); h *= 16777619u; }
+        };
+        mix(current_round);
+        for (auto &p : players) {
+            mix(p.seat); mix(balances[p.seat]); mix(profiles[p.id].current_streak);
+            for (auto &c : p.hand) mix(c.to_byte());
+        }
+        mix(static_cast<std::int64_t>(deck.size()));
+        mix(deck.running_count);
+        return h;
+    }
+    EventLogHeader event_log_header() const {
+        EventLogHeader h;
+        h.seed = config.seed;
+        h.flags = static_cast<std::uint8_t>((config.human_seat ? EventLogHeader::HumanSeat : 0) | (config.rebuy ? EventLogHeader::Rebuy : 0)
+                                            | (config.rebuy ? 0 : EventLogHeader::StartupShoe));
+        h.npc_seats = config.npc_seats;
+        h.starting_chips = starting_chips;
+        h.bet = bet_amount;
+        h.decks = config.decks;
+        for (auto &p : players) h.streaks.push_back(profiles[p.id].current_streak);
+        return h;
+    }
+    // Replays start from the streaks the recorded table loaded from its profiles
+    void set_streaks(const std::vector<std::int64_t>& streaks) {
+        for (auto &p : players) if (p.seat < (int)streaks.size()) profiles[p.id].current_streak = streaks[p.seat];
+    }
 
-        // Post-round achievements
-        if (persistent_stats["You"].total_games >= 20) unlock_achievement_for("You","MARATHONER");
-        if (persistent_stats["You"].total_games >= 50) unlock_achievement_for("You","GAMBLER_SPIRIT");
+    // Between rounds: simulated tables top bankrupt seats up, interactive tables remove them.
+    // Returns false once too few players are left to continue.
+    bool finish_round() {
+        if (config.rebuy) { rebuy_bankrupt_seats(); return true; }
+        for (auto it = players.begin(); it != players.end();) {
+            if (chips_of(*it) <= 0) {
+                out << it->name << " is bankrupt and removed from game.\n";
+                seat_players[it->seat] = nullptr;
+                it = players.erase(it);
+            } else ++it;
+        }
+        if (players.size() <= 1) { out << "Not enough players to continue. Ending game.\n"; return false; }
+        return true;
+    }
 
-        // Summary
-        std::cout << "\nPot total: " << pot_total() << " chips.\n";
+    // Simulated seats never leave: a bankrupt seat is topped back up to the starting stack
+    void rebuy_bankrupt_seats() {
+        for (auto &p : players) {
+            if (chips_of(p) > 0) continue;
+            Chips topup = starting_chips - chips_of(p);
+            audit.on_mint(topup);
+            move_chips(p, topup, LedgerReason::Rebuy);
+        }
+    }
+
+    void show_round_results() {
+        if (config.quiet) return;
+        out << "\nPot total: " << pot_total() << " chips.\n";
         show_recent_transactions(12);
-        std::cout << "\n--- Round Results ---\n";
+        out << "\n--- Round Results ---\n";
         for (auto &p : players) {
-            std::cout << p.name << ": hand(" << p.hand_to_string() << ") value=" << p.hand_value();
-            if (p.busted) std::cout << " " << BRED << "[BUSTED]" << RESET;
-            std::cout << " | chips=" << p.chips;
+            out << p.name << ": hand(" << p.hand_to_string() << ") value=" << p.hand_value();
+            if (p.busted) out << " " << BRED << "[BUSTED]" << RESET;
+            out << " | chips=" << chips_of(p);
             if (!p.wager_history.empty()) {
-                std::cout << " | wagers:";
-                bool first=true;
-                for (int w : p.wager_history) { if (!first) std::cout << ","; std::cout << w; first=false; }
+                const RunningStats &w = p.wager_history.all;
+                out << " | wagers: last=" << p.wager_history.last() << " n=" << w.count
+                    << " avg=" << std::fixed << std::setprecision(1) << w.mean << std::defaultfloat;
             }
-            std::cout << "\n";
+            out << "\n";
         }
-        std::cout << "---------------------\n";
-
-        sync_chip_map_from_players();
-        save_stats_to_file();
-        show_scoreboard_colored();
-        print_round_footer(round_num);
+        out << "---------------------\n";
     }
 
     // Present session stats summary
     void show_stats() {
-        std::cout << "\n" << BOLD << "===== SESSION STATS =====" << RESET << "\n";
-        for (auto &p : stats_wins) {
-            std::cout << p.first << " -> wins: " << p.second
-                      << ", losses: " << stats_losses[p.first]
-                      << ", ties: " << stats_ties[p.first]
-                      << ", blackjacks: " << stats_blackjacks[p.first]
-                      << ", chips: " << chip_map[p.first]
-                      << "\n";
+        out << "\n" << BOLD << "===== SESSION STATS =====" << RESET << "\n";
+        std::vector<Chips> chips(session.size(), 0);
+        for (auto &p : players) chips[p.id] = chips_of(p);
+        for (int id = 0; id < (int)session.size(); ++id) {
+            const SessionStats &ss = session[id];
+            if (!ss.seated) continue;
+            out << profiles.name_of(id) << " -> wins: " << ss.wins
+                << ", losses: " << ss.losses
+                << ", ties: " << ss.ties
+                << ", blackjacks: " << ss.blackjacks
+                << ", chips: " << chips[id]
+                << "\n";
         }
-        std::cout << "=========================\n";
+        out << "--- EV per round, 95% CI ---\n";
+        for (auto &p : players) print_ev_line(out, p.name, ev.seats[p.seat]);
+        out << "=========================\n";
     }
 
     // Achievements browser & profiles menu
     void display_achievements_for(const std::string& player_name) {
-        auto pit = persistent_stats.find(player_name);
-        if (pit == persistent_stats.end()) { std::cout << "No profile named '" << player_name << "'.\n"; return; }
-        const PlayerStats &ps = pit->second;
-        std::cout << "\n=== Achievements for " << player_name << " ===\nUnlocked:\n";
-        if (ps.achievements.empty()) std::cout << "  (none)\n";
+        int id = profiles.find(player_name);
+        if (id < 0) { out << "No profile named '" << player_name << "'.\n"; return; }
+        const PlayerStats &ps = profiles[id];
+        out << "\n=== Achievements for " << player_name << " ===\nUnlocked:\n";
+        if (ps.achievements.empty()) out << "  (none)\n";
         else for (const auto &k : ps.achievements) {
-            auto ait = all_achievements.find(k);
-            std::string desc = ait!=all_achievements.end() ? ait->second : "";
-            std::cout << "  ✔ " << k << " - " << desc << "\n";
+            out << "  ✔ " << k << " - " << achievements.description_of(k) << "\n";
         }
-        std::cout << "\nLocked:\n";
+        out << "\nLocked:\n";
         bool any_locked=false;
-        for (const auto &kv : all_achievements) {
-            if (ps.achievements.find(kv.first) == ps.achievements.end()) {
+        for (const auto &rule : achievements.all()) {
+            if (ps.achievements.find(rule.key) == ps.achievements.end()) {
                 any_locked=true;
-                std::cout << "  ✘ " << kv.first << " - " << kv.second << "\n";
+                out << "  ✘ " << rule.key << " - " << rule.description << "\n";
             }
         }
-        if (!any_locked) std::cout << "  (none — all unlocked!)\n";
-        std::cout << "===============================\n\n";
+        if (!any_locked) out << "  (none — all unlocked!)\n";
+        out << "===============================\n\n";
     }
 
-    void display_profiles_menu() {
+    Task display_profiles_menu() {
         while (true) {
-            std::cout << "\n--- Player Profiles Menu ---\n";
-            std::cout << "1) View all profiles\n2) View specific profile\n3) Reset a profile's stats\n4) Reset ALL stats\n5) Back to game\n6) View achievements for a player\n7) View chip map\n8) View wager history for a player\nChoose: ";
+            out << "\n--- Player Profiles Menu ---\n";
+            out << "1) View all profiles\n2) View specific profile\n3) Reset a profile's stats\n4) Reset ALL stats\n5) Back to game\n6) View achievements for a player\n7) View chip map\n8) View wager history for a player\n9) View outcome histograms\n10) View rolling windows\nChoose: ";
+            auto line = co_await next_line();
+            if (!line) break;
             int choice = 0;
-            if (!(std::cin >> choice)) { std::cin.clear(); std::string _;
-                std::getline(std::cin,_); continue; }
-            std::string dummy; std::getline(std::cin,dummy); // flush newline
+            try { choice = std::stoi(*line); } catch (...) { continue; }
             if (choice == 1) {
-                std::cout << "\n-- All Profiles --\n";
-                for (auto &entry : persistent_stats) {
-                    std::cout << entry.first << " : wins=" << entry.second.wins << " losses=" << entry.second.losses
-                              << " ties=" << entry.second.ties << " total_games=" << entry.second.total_games
-                              << " best_streak=" << entry.second.best_streak << " biggest_win=" << entry.second.biggest_win
-                              << " blackjacks=" << entry.second.blackjacks << " achievements=[";
+                out << "\n-- All Profiles --\n";
+                for (int id = 0; id < profiles.size(); ++id) {
+                    const PlayerStats &ps = profiles[id];
+                    out << profiles.name_of(id) << " : wins=" << ps.wins << " losses=" << ps.losses
+                        << " ties=" << ps.ties << " total_games=" << ps.total_games
+                        << " best_streak=" << ps.best_streak << " biggest_win=" << ps.biggest_win
+                        << " blackjacks=" << ps.blackjacks << " achievements=[";
                     bool first=true;
-                    for (auto &a : entry.second.achievements) { if (!first) std::cout << ", "; std::cout << a; first=false; }
-                    std::cout << "]\n";
+                    for (auto &a : ps.achievements) { if (!first) out << ", "; out << a; first=false; }
+                    out << "]\n";
                 }
             } else if (choice == 2) {
-                std::cout << "Enter player name: "; std::string name; std::getline(std::cin,name);
-                if (persistent_stats.find(name) != persistent_stats.end()) {
-                    auto &ps = persistent_stats[name];
-                    std::cout << name << " : wins=" << ps.wins << " losses=" << ps.losses << " ties=" << ps.ties
-                              << " total_games=" << ps.total_games << " best_streak=" << ps.best_streak << " current_streak=" << ps.current_streak
-                              << " biggest_win=" << ps.biggest_win << " blackjacks=" << ps.blackjacks << " achievements=[";
+                out << "Enter player name: "; std::string name = (co_await next_line()).value_or("");
+                int id = profiles.find(name);
+                if (id >= 0) {
+                    auto &ps = profiles[id];
+                    out << name << " : wins=" << ps.wins << " losses=" << ps.losses << " ties=" << ps.ties
+                        << " total_games=" << ps.total_games << " best_streak=" << ps.best_streak << " current_streak=" << ps.current_streak
+                        << " biggest_win=" << ps.biggest_win << " blackjacks=" << ps.blackjacks << " achievements=[";
                     bool first=true;
-                    for (auto &a : ps.achievements) { if (!first) std::cout << ", "; std::cout << a; first=false; }
-                    std::cout << "]\n";
-                    std::cout << "Chips (from map): " << chip_map[name] << "\n";
-                } else std::cout << "No profile named '" << name << "'.\n";
+                    for (auto &a : ps.achievements) { if (!first) out << ", "; out << a; first=false; }
+                    out << "]\n";
+                    out << "Chips (from map): " << chip_map()[name] << "\n";
+                } else out << "No profile named '" << name << "'.\n";
             } else if (choice == 3) {
-                std::cout << "Enter player name to reset: "; std::string name; std::getline(std::cin,name);
-                if (persistent_stats.find(name) != persistent_stats.end()) {
-                    persistent_stats[name] = PlayerStats{};
-                    for (auto &p : players) if (p.name == name) p.chips = starting_chips;
-                    chip_map[name] = starting_chips;
+                out << "Enter player name to reset: "; std::string name = (co_await next_line()).value_or("");
+                int id = profiles.find(name);
+                if (id >= 0) {
+                    profiles[id] = PlayerStats{};
+                    for (auto &p : players) if (p.name == name) {
+                        audit.on_mint(starting_chips - chips_of(p));
+                        move_chips(p, starting_chips - chips_of(p), LedgerReason::Reset);
+                        achievements.reset_seat(p.seat);
+                        windows[p.seat].clear();
+                    }
                     save_stats_to_file();
-                    std::cout << "Profile reset for " << name << ".\n";
-                } else std::cout << "No profile named '" << name << "'.\n";
+                    out << "Profile reset for " << name << ".\n";
+                } else out << "No profile named '" << name << "'.\n";
             } else if (choice == 4) {
-                for (auto &entry : persistent_stats) entry.second = PlayerStats{};
-                for (auto &p : players) { p.chips = starting_chips; p.wager_history.clear(); chip_map[p.name] = starting_chips; }
+                for (int id = 0; id < profiles.size(); ++id) profiles[id] = PlayerStats{};
+                for (auto &p : players) {
+                    audit.on_mint(starting_chips - chips_of(p));
+                    move_chips(p, starting_chips - chips_of(p), LedgerReason::Reset);
+                    p.wager_history.clear(); achievements.reset_seat(p.seat); windows[p.seat].clear();
+                }
                 save_stats_to_file();
-                std::cout << "All profiles reset.\n";
+                out << "All profiles reset.\n";
             } else if (choice == 5) break;
             else if (choice == 6) {
-                std::cout << "Enter player name for achievements (default: You): ";
-                std::string name; std::getline(std::cin,name); if (name.empty()) name="You";
+                out << "Enter player name for achievements (default: " << config.human_name << "): ";
+                std::string name = (co_await next_line()).value_or(""); if (name.empty()) name=config.human_name;
                 display_achievements_for(name);
             } else if (choice == 7) {
-                std::cout << "\n--- Chip Map ---\n";
-                for (auto &kv : chip_map) std::cout << kv.first << " : " << kv.second << "\n";
+                out << "\n--- Chip Map ---\n";
+                for (auto &kv : chip_map()) out << kv.first << " : " << kv.second << "\n";
             } else if (choice == 8) {
-                std::cout << "Enter player name for wager history (default: You): ";
-                std::string name; std::getline(std::cin,name); if (name.empty()) name="You";
+                out << "Enter player name for wager history (default: " << config.human_name << "): ";
+                std::string name = (co_await next_line()).value_or(""); if (name.empty()) name=config.human_name;
                 bool found=false;
                 for (auto &p : players) if (p.name == name) {
                     found = true;
-                    std::cout << "Wager history for " << name << ": ";
-                    bool first=true;
-                    for (int w : p.wager_history) { if (!first) std::cout << ", "; std::cout << w; first=false; }
-                    std::cout << "\n";
+                    const WagerHistory &wh = p.wager_history;
+                    out << "Wager history for " << name << " (last " << wh.recent_size() << "): ";
+                    for (std::size_t i = 0; i < wh.recent_size(); ++i) { if (i) out << ", "; out << wh.recent_at(i); }
+                    out << "\n";
+                    if (!wh.empty()) {
+                        out << "  count=" << wh.all.count << " sum=" << static_cast<long long>(wh.all.sum)
+                            << " mean=" << std::fixed << std::setprecision(2) << wh.all.mean
+                            << " stddev=" << wh.all.stddev() << std::defaultfloat
+                            << " min=" << wh.all.min << " max=" << wh.all.max << "\n";
+                    }
                 }
-                if (!found) std::cout << "No player named '" << name << "'.\n";
-            } else std::cout << "Unknown choice.\n";
+                if (!found) out << "No player named '" << name << "'.\n";
+            } else if (choice == 9) show_histograms();
+            else if (choice == 10) show_rolling_windows();
+            else out << "Unknown choice.\n";
         }
     }
 
     void end_game() {
-        std::cout << "\nFinal stats and leaderboard:\n";
-        std::deque<std::pair<int,std::string>> leaderboard;
-        for (auto it = players.begin(); it != players.end(); ++it) leaderboard.emplace_back(it->chips, it->name);
+        out << "\nFinal stats and leaderboard:\n";
+        std::deque<std::pair<Chips,std::string>> leaderboard;
+        for (auto it = players.begin(); it != players.end(); ++it) leaderboard.emplace_back(chips_of(*it), it->name);
         std::sort(leaderboard.begin(), leaderboard.end(), [](const auto &a, const auto &b){ return a.first > b.first; });
-        for (std::size_t i=0;i<leaderboard.size();++i) std::cout << (i+1) << ". " << leaderboard[i].second << " - chips: " << leaderboard[i].first << "\n";
+        for (std::size_t i=0;i<leaderboard.size();++i) out << (i+1) << ". " << leaderboard[i].second << " - chips: " << leaderboard[i].first << "\n";
         save_stats_to_file();
-        std::cout << "Thank you for playing!\n";
+        if (audit.enabled) out << "Chip audit: " << audit.rounds_checked << " rounds checked, " << audit.violations << " violations.\n";
+        out << "Thank you for playing!\n";
+        if (bot) {
+            auto human = std::find_if(players.begin(), players.end(), [](const Player& p) { return p.is_human; });
+            JsonLine("over").num("rounds", current_round).flag("seated", human != players.end())
+                .num("chips", human != players.end() ? chips_of(*human) : 0).send(bot);
+        }
     }
 
     // main game loop
     void game_loop() {
         startup_config();
         bool playing = true;
-        int round = 0;
+        std::int64_t round = 0;
         while (playing) {
             round++;
             play_round(round);
             show_stats();
-            std::cout << "Play another round? (y/n) or (p) profiles: ";
+            out << "Play another round? (y/n) or (p) profiles: ";
             char c = 'n';
             std::string in;
-            std::getline(std::cin, in);
-            if (in.empty()) std::getline(std::cin,in);
+            std::getline(*input, in);
+            if (in.empty()) std::getline(*input,in);
             if (!in.empty()) c = in[0];
             if (c == 'n' || c == 'N') playing = false;
-            if (c == 'p' || c == 'P') display_profiles_menu();
-            // remove bankrupt players
-            for (auto it = players.begin(); it != players.end();) {
-                if (it->chips <= 0) {
-                    std::cout << it->name << " is bankrupt and removed from game.\n";
-                    chip_map.erase(it->name);
-                    it = players.erase(it);
-                } else ++it;
-            }
-            if (players.size() <= 1) { std::cout << "Not enough players to continue. Ending game.\n"; break; }
+            if (c == 'p' || c == 'P') run_blocking(display_profiles_menu());
+            if (!finish_round()) break;
         }
         end_game();
     }
 };
 
+// -----------------------------
+// Headless simulation: one quiet table per worker thread, EV shards merged at the end
+// -----------------------------
+// Upper bound for --precision without --simulate, so a seat that never converges can't run forever
+static const long long kPrecisionRoundCap = 100000000;
+
+struct SimOptions {
+    long long rounds = 100000;      // total rounds, or the cap when a precision target is set
+    int threads = 0;                // 0 = one per hardware thread
+    int seats = 4;
+    bool audit = false;
+    bool histograms = false;
+    double precision_pct = 0.0;     // > 0: stop once every seat's EV CI half-width is within this % of wager
+    double z = 1.96;                // critical value for the requested confidence
+    std::string checkpoint;         // non-empty: periodically write worker state here
+    int checkpoint_secs = 60;
+    std::string resume;             // non-empty: continue the run saved in this checkpoint
+    std::string history;            // non-empty: write each worker's hand history into this directory
+    std::string events;             // non-empty: write each worker's binary event log into this directory
+    std::uint64_t seed = 0;         // non-zero: worker t seeds its table with seed + t
+};
+
+// DIR/<stem>-<table><ext>, one file per table
+static std::string table_path(const std::string& dir, const char* stem, int table, const char* ext) {
+    return (std::filesystem::path(dir) / (stem + ("-" + std::to_string(table)) + ext)).string();
+}
+static std::string history_path(const std::string& dir, int table) { return table_path(dir, "hands", table, ".bjh"); }
+static std::string events_path(const std::string& dir, int table) { return table_path(dir, "events", table, ".bjev"); }
+
+// On resume, cut a per-table file back to the size the checkpoint recorded
+static void truncate_to_checkpoint(const std::string& path, std::uint64_t bytes) {
+    if (std::filesystem::exists(path) && std::filesystem::file_size(path) > bytes) std::filesystem::resize_file(path, bytes);
+}
+
+static double z_for_confidence(int pct) {
+    if (pct == 90) return 1.645;
+    if (pct == 99) return 2.576;
+    if (pct == 95) return 1.96;
+    throw std::runtime_error("confidence must be 90, 95 or 99");
+}
+
+static TableConfig simulation_table(const SimOptions& opt) {
+    TableConfig cfg;
+    cfg.starting_chips = 200;
+    cfg.bet = 20;
+    cfg.human_seat = false;
+    cfg.npc_seats = opt.seats;
+    cfg.quiet = true;
+    cfg.persist = false;
+    cfg.rebuy = true;
+    return cfg;
+}
+
+// Per-worker snapshot of the per-seat EV accumulators, published under a seqlock so the
+// reporter thread can sample it without ever blocking the worker. Only the owning worker writes.
+struct ShardMailbox {
+    struct Seat {
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<double> mean{0.0};
+        std::atomic<double> m2{0.0};
+    };
+    std::atomic<std::uint64_t> seq{0};          // odd while a publish is in progress
+    std::atomic<long long> rounds{0};
+    std::unique_ptr<Seat[]> seats;
+    int seat_count = 0;
+
+    explicit ShardMailbox(int n) : seats(new Seat[n]), seat_count(n) {}
+
+    void publish(const StatsShard& shard, long long rounds_done) {
+        std::uint64_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int i = 0; i < seat_count; ++i) {
+            const RunningStats &rs = shard.seats[i].per_unit;
+            seats[i].count.store(rs.count, std::memory_order_relaxed);
+            seats[i].mean.store(rs.mean, std::memory_order_relaxed);
+            seats[i].m2.store(rs.m2, std::memory_order_relaxed);
+        }
+        rounds.store(rounds_done, std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+    // Copies a consistent snapshot into out (per seat); retries while a publish is in flight
+    long long sample(std::vector<RunningStats>& out) const {
+        out.assign(seat_count, RunningStats{});
+        while (true) {
+            std::uint64_t s1 = seq.load(std::memory_order_acquire);
+            if (s1 & 1) { std::this_thread::yield(); continue; }
+            for (int i = 0; i < seat_count; ++i) {
+                out[i].count = seats[i].count.load(std::memory_order_relaxed);
+                out[i].mean = seats[i].mean.load(std::memory_order_relaxed);
+                out[i].m2 = seats[i].m2.load(std::memory_order_relaxed);
+            }
+            long long r = rounds.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s1) return r;
+        }
+    }
+};
+
+// Hand-off slot between one worker and the checkpoint writer. The worker serializes its table
+// into a private buffer and only swaps it in when try_lock succeeds, so it never waits on disk.
+struct CheckpointSlot {
+    std::mutex m;
+    std::string blob;
+    long long played = 0;
+    unsigned epoch = ~0u;   // the writer's request this blob answers
+    bool final = false;     // the worker is done; blob is its last state
+};
+
+static const char* kCheckpointMagic = "BJCHECKPOINT";
+
+// Header: options that determine the run, then one length-prefixed table state per worker.
+// Written to a temp file and renamed over the old checkpoint so a kill never leaves it torn.
+static bool write_checkpoint(const SimOptions& opt, int threads, std::vector<std::unique_ptr<CheckpointSlot>>& slots) {
+    std::vector<std::pair<long long,std::string>> copies;
+    for (auto &slot : slots) {
+        std::lock_guard<std::mutex> lock(slot->m);
+        if (slot->blob.empty()) return false;   // a worker hasn't produced a snapshot yet
+        copies.emplace_back(slot->played, slot->blob);
+    }
+    std::string tmp = opt.checkpoint + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc | std::ios::binary);
+        if (!f) { std::cerr << "Warning: cannot write checkpoint " << tmp << "\n"; return false; }
+        f << kCheckpointMagic << " 3\n" << threads << ' ' << opt.seats << ' ' << opt.rounds << ' '
+          << std::setprecision(17) << opt.precision_pct << ' ' << opt.z << '\n';
+        for (std::size_t t = 0; t < copies.size(); ++t)
+            f << "worker " << t << ' ' << copies[t].first << ' ' << copies[t].second.size() << '\n' << copies[t].second;
+        if (!f.flush()) { std::cerr << "Warning: checkpoint write failed\n"; return false; }
+    }
+    return std::rename(tmp.c_str(), opt.checkpoint.c_str()) == 0;
+}
+
+// Reads a checkpoint back into the run options and per-worker (played, state) pairs
+static std::vector<std::pair<long long,std::string>> read_checkpoint(const std::string& path, SimOptions& opt) {
+    std::ifstream f(path, std::ios::binary);
+    std::string magic;
+    int version = 0, threads = 0;
+    if (!(f >> magic >> version) || magic != kCheckpointMagic || version != 3) throw std::runtime_error("not a checkpoint file: " + path);
+    f >> threads >> opt.seats >> opt.rounds >> opt.precision_pct >> opt.z;
+    if (!f || threads < 1) throw std::runtime_error("corrupt checkpoint header: " + path);
+    opt.threads = threads;
+    std::vector<std::pair<long long,std::string>> workers(threads);
+    for (int t = 0; t < threads; ++t) {
+        std::string tag;
+        int idx = -1;
+        std::size_t len = 0;
+        f >> tag >> idx >> workers[t].first >> len;
+        f.get();
+        if (!f || tag != "worker" || idx != t) throw std::runtime_error("corrupt checkpoint worker record");
+        workers[t].second.resize(len);
+        if (!f.read(&workers[t].second[0], static_cast<std::streamsize>(len))) throw std::runtime_error("truncated checkpoint");
+    }
+    return workers;
+}
+
+static int run_simulation(SimOptions opt) {
+    static const long long kPublishEvery = 1024;
+    static const std::uint64_t kMinSamples = 1000;   // don't trust a CI before this many rounds
+
+    std::vector<std::pair<long long,std::string>> resumed;
+    if (!opt.resume.empty()) {
+        resumed = read_checkpoint(opt.resume, opt);
+        if (opt.checkpoint.empty()) opt.checkpoint = opt.resume;
+    }
+    int threads = opt.threads > 0 ? opt.threads : std::max(1u, std::thread::hardware_concurrency());
+    TableConfig cfg = simulation_table(opt);
+    bool adaptive = opt.precision_pct > 0.0;
+    double target = opt.precision_pct / 100.0;
+    std::vector<StatsShard> shards(threads);
+    std::vector<std::unique_ptr<ShardMailbox>> mailboxes;
+    for (int t = 0; t < threads; ++t) mailboxes.emplace_back(new ShardMailbox(opt.seats));
+    std::atomic<bool> stop{false};
+    std::atomic<int> running{threads};
+    std::vector<long long> played(threads, 0);
+    long long resumed_rounds = 0;
+    for (auto &w : resumed) resumed_rounds += w.first;
+    bool checkpointing = !opt.checkpoint.empty();
+    std::vector<std::unique_ptr<CheckpointSlot>> slots;
+    for (int t = 0; t < threads; ++t) slots.emplace_back(new CheckpointSlot);
+    std::atomic<unsigned> checkpoint_epoch{0};   // bumped by the writer to request fresh snapshots
+    std::vector<std::pair<std::uint64_t,std::uint64_t>> event_totals(threads);   // event log bytes, hands per worker
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        long long share = opt.rounds / threads + (t < opt.rounds % threads ? 1 : 0);
+        workers.emplace_back([&, t, share] {
+            TableConfig table = cfg;
+            if (opt.seed) table.seed = opt.seed + static_cast<std::uint64_t>(t);
+            BlackjackGame game(table);
+            game.set_audit(opt.audit);
+            long long r = 0;
+            std::uint64_t history_bytes = 0, event_bytes = 0;
+            if (!resumed.empty()) {
+                std::istringstream is(resumed[t].second);
+                std::string tag;
+                is >> tag >> history_bytes >> tag >> event_bytes;
+                game.load_state(is);
+                r = resumed[t].first;
+            }
+            // Output written after the checkpoint is dropped; those rounds are played again from its state
+            std::unique_ptr<HandHistoryWriter> history;
+            if (!opt.history.empty()) {
+                std::string path = history_path(opt.history, t);
+                if (!resumed.empty()) truncate_to_checkpoint(path, history_bytes);
+                history.reset(new HandHistoryWriter(path));
+                game.set_history(history.get());
+            }
+            std::unique_ptr<EventLogWriter> events;
+            if (!opt.events.empty()) {
+                std::string path = events_path(opt.events, t);
+                if (!resumed.empty()) truncate_to_checkpoint(path, event_bytes);
+                events.reset(new EventLogWriter(path, !resumed.empty()));
+                game.set_event_log(events.get());
+            }
+            const std::uint64_t events_at_start = events ? events->committed_bytes() : 0;
+            unsigned seen_epoch = ~0u;
+            auto snapshot = [&] {
+                std::ostringstream os;
+                if (history) history->flush();
+                if (events) events->commit();
+                os << "history_bytes " << (history ? history->flushed_bytes() : 0)
+                   << " event_bytes " << (events ? events->committed_bytes() : 0) << '\n';
+                game.save_state(os);
+                return os.str();
+            };
+            while (r < share && !stop.load(std::memory_order_relaxed)) {
+                ++r;
+                game.play_round(r);
+                game.finish_round();
+                if (adaptive && r % kPublishEvery == 0) mailboxes[t]->publish(game.ev_stats(), r);
+                unsigned epoch = checkpoint_epoch.load(std::memory_order_relaxed);
+                if (checkpointing && epoch != seen_epoch) {
+                    std::string blob = snapshot();
+                    if (slots[t]->m.try_lock()) {
+                        slots[t]->blob.swap(blob);
+                        slots[t]->played = r;
+                        slots[t]->epoch = epoch;
+                        slots[t]->m.unlock();
+                        seen_epoch = epoch;
+                    }
+                }
+            }
+            if (checkpointing) {
+                std::string blob = snapshot();
+                std::lock_guard<std::mutex> lock(slots[t]->m);
+                slots[t]->blob.swap(blob);
+                slots[t]->played = r;
+                slots[t]->final = true;
+            }
+            shards[t] = game.ev_stats();
+            played[t] = r;
+            if (events) {
+                events->close();
+                event_totals[t] = {events->committed_bytes() - events_at_start, events->hands_logged()};
+            }
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    // Checkpoint writer: every checkpoint_secs, ask for new snapshots, give the workers up to a
+    // second to answer between rounds, then write. A kill loses at most one interval of work.
+    std::mutex writer_mutex;
+    std::condition_variable writer_cv;
+    bool writer_done = false;
+    std::thread writer;
+    if (checkpointing) {
+        writer = std::thread([&] {
+            std::unique_lock<std::mutex> lock(writer_mutex);
+            while (!writer_cv.wait_for(lock, std::chrono::seconds(std::max(1, opt.checkpoint_secs)), [&] { return writer_done; })) {
+                lock.unlock();
+                unsigned want = checkpoint_epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+                auto answered = [&] {
+                    for (auto &slot : slots) {
+                        std::lock_guard<std::mutex> slot_lock(slot->m);
+                        if (!slot->final && slot->epoch != want) return false;
+                    }
+                    return true;
+                };
+                auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+                while (!answered() && std::chrono::steady_clock::now() < until) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                write_checkpoint(opt, threads, slots);
+                lock.lock();
+            }
+        });
+    }
+
+    // Reporter: merge the published snapshots, print progress, and stop the workers once
+    // every seat's EV interval is narrow enough.
+    bool converged = false;
+    if (adaptive) {
+        std::vector<RunningStats> snap;
+        while (running.load(std::memory_order_acquire) > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            std::vector<RunningStats> merged(opt.seats);
+            long long rounds = 0;
+            for (auto &mb : mailboxes) {
+                rounds += mb->sample(snap);
+                for (int i = 0; i < opt.seats; ++i) merged[i].merge(snap[i]);
+            }
+            double worst = 0.0;
+            bool ready = true;
+            for (auto &rs : merged) {
+                if (rs.count < kMinSamples) ready = false;
+                worst = std::max(worst, rs.ci(opt.z));
+            }
+            std::cerr << "\r" << rounds << " rounds, widest EV interval ±" << std::fixed << std::setprecision(3)
+                      << worst * 100.0 << "% (target ±" << opt.precision_pct << "%)" << std::defaultfloat << std::flush;
+            if (ready && worst <= target) { converged = true; stop.store(true, std::memory_order_relaxed); break; }
+        }
+        std::cerr << "\n";
+    }
+    for (auto &w : workers) w.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long long total_rounds = std::accumulate(played.begin(), played.end(), 0LL);
+    if (checkpointing) {
+        { std::lock_guard<std::mutex> lock(writer_mutex); writer_done = true; }
+        writer_cv.notify_one();
+        writer.join();
+        if (write_checkpoint(opt, threads, slots)) std::cerr << "Checkpoint written to " << opt.checkpoint << "\n";
+    }
+
+    StatsShard total;
+    for (auto &s : shards) total.merge(s);
+    std::cout << BOLD << "===== SIMULATION: " << total_rounds << " rounds x " << threads << " threads ("
+              << std::fixed << std::setprecision(0) << (total_rounds - resumed_rounds) / std::max(secs, 1e-9) << " rounds/s) =====" << RESET << std::defaultfloat << "\n";
+    if (resumed_rounds) std::cout << "Resumed from " << opt.resume << " at " << resumed_rounds << " rounds.\n";
+    if (!opt.events.empty()) {
+        std::uint64_t bytes = 0, hands = 0;
+        for (auto &e : event_totals) { bytes += e.first; hands += e.second; }
+        std::cout << "Event log: " << bytes << " bytes for " << hands << " hands this run ("
+                  << std::fixed << std::setprecision(2) << (hands ? static_cast<double>(bytes) / static_cast<double>(hands) : 0.0)
+                  << " bytes/hand).\n" << std::defaultfloat;
+    }
+    if (adaptive) {
+        std::cout << (converged ? "Stopped early: every seat reached " : "Round cap reached before every seat reached ")
+                  << "±" << std::setprecision(4) << opt.precision_pct << "% of wager (z=" << opt.z << ").\n";
+    }
+    std::cout << "-- per seat (summed over tables) --\n";
+    for (int i = 0; i < (int)total.seats.size(); ++i) print_ev_line(std::cout, make_npc(i).name, total.seats[i]);
+    std::cout << "-- per personality --\n";
+    for (int i = 0; i < kPersonalityCount; ++i)
+        if (total.personalities[i].net.count) print_ev_line(std::cout, PersonalityNames[i], total.personalities[i]);
+    if (opt.histograms) {
+        std::cout << "-- outcome histograms per seat --\n";
+        for (int i = 0; i < (int)total.seat_hists.size(); ++i) dump_outcome_histograms(std::cout, make_npc(i).name, total.seat_hists[i]);
+        std::cout << "-- outcome histograms per personality --\n";
+        for (int i = 0; i < kPersonalityCount; ++i)
+            if (total.personality_hists[i].hand.total()) dump_outcome_histograms(std::cout, PersonalityNames[i], total.personality_hists[i]);
+    }
+    return 0;
+}
+
+// -----------------------------
+// Hand history queries: predicates on one-byte columns are evaluated chunk by chunk into
+// row bitmaps (64 rows per word), ANDed together and popcounted. Chunks whose min/max rule
+// out a predicate are skipped without reading them; only the columns a query needs are read.
+// Chunks are shared out over a fixed set of threads.
+// -----------------------------
+struct HistoryChunkInfo {
+    std::size_t file = 0;                       // index into the query's file list
+    std::uint32_t rows = 0;
+    std::array<std::uint64_t,kHistoryColumnCount> offset{};   // absolute file offset of each column block
+    std::array<std::uint64_t,kHistoryColumnCount> bytes{};
+    std::array<std::int64_t,kHistoryColumnCount> min{};
+    std::array<std::int64_t,kHistoryColumnCount> max{};
+};
+
+// Reads only the chunk headers, seeking over the column data. A final chunk cut short (a
+// killed --history run) is left out with a warning.
+static void read_history_chunks(const std::string& path, std::size_t file, std::vector<HistoryChunkInfo>& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot open hand history file " + path);
+    const std::uint64_t size = std::filesystem::file_size(path);
+    const std::size_t kFixed = sizeof kHistoryChunkMagic + 4 + 2;
+    const std::size_t kPerColumn = 1 + 1 + 8 + 8 + 8;
+    unsigned char head[kFixed];
+    auto cut_short = [&](std::uint64_t at) {
+        std::cerr << "Warning: " << path << " ends inside a chunk; ignoring its last " << size - at << " bytes\n";
+    };
+    std::uint64_t at = 0;
+    while (in.read(reinterpret_cast<char*>(head), kFixed)) {
+        if (!std::equal(head, head + 4, kHistoryChunkMagic)) throw std::runtime_error("corrupt hand history chunk in " + path);
+        HistoryChunkInfo chunk;
+        chunk.file = file;
+        chunk.rows = get_le<std::uint32_t>(head + 4);
+        int columns = get_le<std::uint16_t>(head + 8);
+        std::vector<unsigned char> desc(columns * kPerColumn);
+        if (!in.read(reinterpret_cast<char*>(desc.data()), static_cast<std::streamsize>(desc.size()))) { cut_short(at); return; }
+        std::uint64_t pos = static_cast<std::uint64_t>(in.tellg());
+        for (int c = 0; c < columns; ++c) {
+            const unsigned char* d = desc.data() + c * kPerColumn;
+            int id = d[0];
+            std::uint64_t len = get_le<std::uint64_t>(d + 2);
+            if (id < kHistoryColumnCount) {
+                chunk.offset[id] = pos;
+                chunk.bytes[id] = len;
+                chunk.min[id] = get_le<std::int64_t>(d + 10);
+                chunk.max[id] = get_le<std::int64_t>(d + 18);
+            }
+            pos += len;
+        }
+        if (pos > size) { cut_short(at); return; }
+        out.push_back(chunk);
+        in.seekg(static_cast<std::streamoff>(pos));
+        at = pos;
+    }
+    if (in.gcount() > 0) cut_short(at);
+}
+
+// column in [lo, hi]
+struct HistoryPredicate {
+    HistoryColumn col = HistoryColumn::Seat;
+    std::int64_t lo = 0;
+    std::int64_t hi = 0;
+};
+
+// "seat=2", "start=12..16", "personality=Cautious", "outcome=bust"
+static HistoryPredicate parse_history_predicate(const std::string& text) {
+    std::size_t eq = text.find('=');
+    if (eq == std::string::npos) throw std::runtime_error("expected column=value: " + text);
+    std::string name = text.substr(0, eq), value = text.substr(eq + 1);
+    auto it = std::find(HistoryColumnNames.begin(), HistoryColumnNames.end(), name);
+    int c = static_cast<int>(it - HistoryColumnNames.begin());
+    if (it == HistoryColumnNames.end() || HistoryColumnWidth[c] != 1 || static_cast<HistoryColumn>(c) == HistoryColumn::Cards)
+        throw std::runtime_error("not a queryable column: " + name);
+    HistoryPredicate p;
+    p.col = static_cast<HistoryColumn>(c);
+    auto lookup = [&](const auto& names) -> std::int64_t {
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            std::string n = names[i];
+            if (n.size() == value.size() && std::equal(n.begin(), n.end(), value.begin(),
+                    [](char a, char b) { return std::tolower((unsigned char)a) == std::tolower((unsigned char)b); }))
+                return static_cast<std::int64_t>(i);
+        }
+        throw std::runtime_error("unknown " + name + ": " + value);
+    };
+    if (p.col == HistoryColumn::Personality) p.lo = p.hi = lookup(PersonalityNames);
+    else if (p.col == HistoryColumn::Outcome) p.lo = p.hi = lookup(HandOutcomeNames);
+    else {
+        std::size_t dots = value.find("..");
+        p.lo = std::stoll(value.substr(0, dots));
+        p.hi = dots == std::string::npos ? p.lo : std::stoll(value.substr(dots + 2));
+        if (p.lo > p.hi) throw std::runtime_error("empty range " + value + " for " + name + " (lo > hi)");
+    }
+    return p;
+}
+
+// bits[i/64] bit i%64 = (lo <= col[i] <= hi), for n rows; bits must hold (n + 63) / 64 words
+static void scan_byte_range(const std::uint8_t* col, std::size_t n, std::uint8_t lo, std::uint8_t hi, std::uint64_t* bits) {
+    const std::uint8_t span = static_cast<std::uint8_t>(hi - lo);
+    std::size_t i = 0;
+#ifdef __SSE2__
+    // x - lo <= span as an unsigned byte compare: min(x - lo, span) == x - lo
+    const __m128i vlo = _mm_set1_epi8(static_cast<char>(lo)), vspan = _mm_set1_epi8(static_cast<char>(span));
+    for (; i + 64 <= n; i += 64) {
+        std::uint64_t word = 0;
+        for (int k = 0; k < 4; ++k) {
+            __m128i x = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(col + i + 16 * k)), vlo);
+            __m128i in = _mm_cmpeq_epi8(_mm_min_epu8(x, vspan), x);
+            word |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(in))) << (16 * k);
+        }
+        bits[i / 64] = word;
+    }
+#endif
+    for (; i < n; i += 64) {
+        std::uint64_t word = 0;
+        for (std::size_t k = 0; k < 64 && i + k < n; ++k)
+            word |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(col[i + k] - lo) <= span) << k;
+        bits[i / 64] = word;
+    }
+}
+
+struct QueryResult {
+    std::uint64_t rows = 0;
+    std::uint64_t matched = 0;
+    std::uint64_t chunks = 0;
+    std::uint64_t skipped = 0;
+    std::array<std::uint64_t,3> outcomes{};
+    Chips net = 0;
+    void merge(const QueryResult& o) {
+        rows += o.rows; matched += o.matched; chunks += o.chunks; skipped += o.skipped; net += o.net;
+        for (std::size_t i = 0; i < outcomes.size(); ++i) outcomes[i] += o.outcomes[i];
+    }
+};
+
+class HistoryQuery {
+private:
+    std::vector<std::string> files;
+    std::vector<HistoryChunkInfo> chunks;
+    std::vector<HistoryPredicate> preds;
+
+    static void read_column(std::ifstream& in, const HistoryChunkInfo& c, HistoryColumn col, std::vector<std::uint8_t>& buf) {
+        int i = static_cast<int>(col);
+        buf.resize(c.bytes[i]);
+        in.seekg(static_cast<std::streamoff>(c.offset[i]));
+        if (!in.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(buf.size())))
+            throw std::runtime_error("truncated hand history chunk");
+    }
+
+    void run_chunk(std::ifstream& in, const HistoryChunkInfo& c, QueryResult& r) const {
+        ++r.chunks;
+        r.rows += c.rows;
+        for (auto &p : preds) {
+            int i = static_cast<int>(p.col);
+            if (p.hi < c.min[i] || p.lo > c.max[i]) { ++r.skipped; return; }
+        }
+        std::size_t words = (c.rows + 63) / 64;
+        std::vector<std::uint64_t> match(words, ~std::uint64_t(0)), bits(words);
+        if (c.rows % 64) match[words - 1] = (std::uint64_t(1) << (c.rows % 64)) - 1;
+        std::vector<std::uint8_t> col;
+        for (auto &p : preds) {
+            int i = static_cast<int>(p.col);
+            if (p.lo <= c.min[i] && c.max[i] <= p.hi) continue;   // every row in the chunk passes
+            read_column(in, c, p.col, col);
+            std::uint8_t lo = static_cast<std::uint8_t>(std::max<std::int64_t>(p.lo, 0));
+            std::uint8_t hi = static_cast<std::uint8_t>(std::min<std::int64_t>(p.hi, 255));
+            scan_byte_range(col.data(), c.rows, lo, hi, bits.data());
+            for (std::size_t w = 0; w < words; ++w) match[w] &= bits[w];
+        }
+        std::uint64_t n = 0;
+        for (auto w : match) n += __builtin_popcountll(w);
+        if (n == 0) return;
+        r.matched += n;
+        std::vector<std::uint8_t> outcome, bet, payout;
+        read_column(in, c, HistoryColumn::Outcome, outcome);
+        read_column(in, c, HistoryColumn::Bet, bet);
+        read_column(in, c, HistoryColumn::Payout, payout);
+        for (std::size_t w = 0; w < words; ++w) {
+            for (std::uint64_t m = match[w]; m; m &= m - 1) {
+                std::size_t row = w * 64 + __builtin_ctzll(m);
+                ++r.outcomes[std::min<std::size_t>(outcome[row], r.outcomes.size() - 1)];
+                r.net += get_le<std::int64_t>(payout.data() + 8 * row) - get_le<std::int64_t>(bet.data() + 8 * row);
+            }
+        }
+    }
+
+public:
+    // path is a .bjh file or a directory of them
+    explicit HistoryQuery(const std::string& path) {
+        if (std::filesystem::is_directory(path)) {
+            for (auto &e : std::filesystem::directory_iterator(path))
+                if (e.path().extension() == ".bjh") files.push_back(e.path().string());
+            std::sort(files.begin(), files.end());
+        } else files.push_back(path);
+        for (std::size_t f = 0; f < files.size(); ++f) read_history_chunks(files[f], f, chunks);
+    }
+    void add_predicate(const HistoryPredicate& p) { preds.push_back(p); }
+    std::size_t file_count() const { return files.size(); }
+
+    QueryResult run(int threads) const {
+        threads = std::max(1, std::min<int>(threads, static_cast<int>(std::max<std::size_t>(chunks.size(), 1))));
+        std::vector<QueryResult> partial(threads);
+        std::vector<std::exception_ptr> errors(threads);
+        std::atomic<std::size_t> next{0};
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] {
+                std::vector<std::ifstream> handles(files.size());
+                try {
+                    for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < chunks.size();) {
+                        const HistoryChunkInfo &c = chunks[i];
+                        if (!handles[c.file].is_open()) handles[c.file].open(files[c.file], std::ios::binary);
+                        run_chunk(handles[c.file], c, partial[t]);
+                    }
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                    next.store(chunks.size(), std::memory_order_relaxed);   // the others stop at their next chunk
+                }
+            });
+        }
+        for (auto &th : pool) th.join();
+        for (auto &e : errors) if (e) std::rethrow_exception(e);
+        QueryResult total;
+        for (auto &p : partial) total.merge(p);
+        return total;
+    }
+};
+
+static int run_query(const std::string& path, const std::vector<std::string>& predicates, int threads) {
+    auto start = std::chrono::steady_clock::now();
+    HistoryQuery q(path);
+    for (auto &p : predicates) q.add_predicate(parse_history_predicate(p));
+    if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    QueryResult r;
+    try { r = q.run(threads); }
+    catch (const std::exception& ex) { std::cerr << "Query failed: " << ex.what() << "\n"; return 1; }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Scanned " << r.rows << " hands in " << r.chunks << " chunks (" << r.skipped << " skipped) from "
+              << q.file_count() << " files in " << std::fixed << std::setprecision(3) << secs << "s\n";
+    std::cout << "Matched " << r.matched << " hands";
+    if (r.rows) std::cout << " (" << std::setprecision(2) << 100.0 * r.matched / r.rows << "%)";
+    std::cout << "\n";
+    if (r.matched) {
+        std::cout << "  outcome:";
+        for (std::size_t i = 0; i < r.outcomes.size(); ++i)
+            std::cout << " " << HandOutcomeNames[i] << "=" << r.outcomes[i] << " (" << 100.0 * r.outcomes[i] / r.matched << "%)";
+        std::cout << "\n  net per hand: " << static_cast<double>(r.net) / r.matched << " chips\n";
+    }
+    std::cout << std::defaultfloat;
+    return 0;
+}
+
+// -----------------------------
+// Replay: rebuild a recorded table from its event log header, feed the human seat's logged
+// decisions back in as input, and play every round through the engine, comparing the state
+// digest after each round with the recorded one. --round N seeks to N through the .idx
+// sidecar, prints the recorded events of that round and replays it with table output on.
+// -----------------------------
+struct ReplayRound {
+    std::int64_t round = 0;
+    std::uint32_t digest = 0;
+    bool complete = false;          // the round-end digest was logged
+    std::string human_input;        // the human seat's bet and actions, one per line
+    std::vector<LoggedEvent> events;
+};
+
+// Reads events up to the next round end. The first event must begin a round, except for
+// chip adjustments between rounds, which the engine regenerates.
+static bool read_replay_round(EventLogReader& log, const EventLogHeader& h, ReplayRound& r, bool keep_events) {
+    r = ReplayRound{};
+    LoggedEvent e;
+    bool started = false;
+    const bool human = h.flags & EventLogHeader::HumanSeat;
+    while (log.next(e)) {
+        if (e.type == LogEvent::Round && e.seat == kRoundBegin) { started = true; r.round = e.value; continue; }
+        if (!started) continue;
+        if (e.type == LogEvent::Round) { r.digest = static_cast<std::uint32_t>(e.value); r.complete = true; return true; }
+        if (keep_events) r.events.push_back(e);
+        if (!human || e.seat != 0) continue;   // the human always sits at seat 0
+        switch (e.type) {
+            case LogEvent::Bet: r.human_input += std::to_string(e.value) + "\n"; break;
+            case LogEvent::Hit: r.human_input += "h\n"; break;
+            case LogEvent::Stand: r.human_input += "s\n"; break;
+            case LogEvent::Discard: r.human_input += "d\n"; break;
+            default: break;
+        }
+    }
+    return started;
+}
+
+static std::string describe_event(const LoggedEvent& e) {
+    static const std::array<const char*,8> names = {"round","deal","hit","stand","discard","bet","payout","adjust"};
+    std::ostringstream oss;
+    oss << "seat " << std::setw(2) << e.seat << " " << std::left << std::setw(8) << names[static_cast<int>(e.type)] << std::right;
+    if (e.type == LogEvent::Deal || e.type == LogEvent::Hit || e.type == LogEvent::Discard) {
+        int b = static_cast<int>(e.value);
+        oss << Card(RankNames[(b / 4) % 13], static_cast<Suit>(b % 4)).shortString();
+    } else if (e.type != LogEvent::Stand) oss << e.value;
+    return oss.str();
+}
+
+// Offset of the last indexed round at or before target (0 = start of the log). The index
+// can run ahead of a log cut short by a crash, so entries past its end are ignored.
+static std::uint64_t index_offset_for(const std::string& log_path, std::int64_t target) {
+    std::ifstream idx(log_path + ".idx", std::ios::binary);
+    const std::uint64_t size = std::filesystem::file_size(log_path);
+    unsigned char entry[16];
+    std::uint64_t best = 0;
+    while (idx.read(reinterpret_cast<char*>(entry), sizeof entry)) {
+        std::int64_t round = get_le<std::int64_t>(entry);
+        std::uint64_t offset = get_le<std::uint64_t>(entry + 8);
+        if (round <= target && offset < size) best = offset;
+    }
+    return best;
+}
+
+static int run_replay(const std::string& path, std::int64_t show_round) {
+    EventLogReader log(path);
+    EventLogHeader h;
+    log.read_header(h);
+
+    if (show_round > 0) {
+        EventLogReader seek_log(path);
+        std::uint64_t offset = index_offset_for(path, show_round);
+        if (offset) seek_log.seek(offset); else seek_log.read_header(h);
+        ReplayRound r;
+        while (read_replay_round(seek_log, h, r, true) && r.round < show_round) {}
+        if (r.round != show_round) { std::cerr << "Round " << show_round << " is not in " << path << "\n"; return 1; }
+        std::cout << BOLD << "Recorded events, round " << r.round << RESET << " (from offset " << offset << ")\n";
+        for (auto &e : r.events) std::cout << "  " << describe_event(e) << "\n";
+        if (r.complete) std::cout << "  digest " << std::hex << r.digest << std::dec << "\n";
+    }
+
+    TableConfig cfg;
+    cfg.starting_chips = h.starting_chips;
+    cfg.bet = h.bet;
+    cfg.decks = h.decks;
+    cfg.human_seat = h.flags & EventLogHeader::HumanSeat;
+    cfg.npc_seats = h.npc_seats;
+    cfg.quiet = true;
+    cfg.persist = false;
+    cfg.rebuy = h.flags & EventLogHeader::Rebuy;
+    cfg.seed = h.seed;
+    cfg.remote = true;   // decisions come from the log
+    BlackjackGame game(cfg);
+    game.set_streaks(h.streaks);
+    if (h.flags & EventLogHeader::StartupShoe) game.apply_shoe(h.decks);
+
+    auto start = std::chrono::steady_clock::now();
+    std::int64_t rounds = 0, divergent = 0, first_divergent = 0;
+    ReplayRound r;
+    std::istringstream human;
+    game.set_input(&human);
+    while (read_replay_round(log, h, r, false)) {
+        if (!r.complete) break;   // the session ended mid-round
+        human.clear();
+        human.str(r.human_input);
+        bool show = r.round == show_round;
+        if (show) { std::cout << BOLD << "Engine replay, round " << r.round << RESET << "\n"; game.set_quiet(false); }
+        game.play_round(r.round);
+        if (show) game.set_quiet(true);
+        ++rounds;
+        std::uint32_t d = game.state_digest();
+        if (d != r.digest) {
+            if (!divergent++) first_divergent = r.round;
+            if (divergent <= 5) std::cerr << "Round " << r.round << ": digest " << std::hex << d << " != recorded " << r.digest << std::dec << "\n";
+        }
+        if (show_round > 0 && r.round >= show_round) break;
+        if (!game.finish_round()) break;
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Replayed " << rounds << " rounds (seed " << h.seed << ") in " << std::fixed << std::setprecision(3) << secs << "s, "
+              << std::setprecision(0) << rounds / std::max(secs, 1e-9) << " rounds/s" << std::defaultfloat << "\n";
+    if (divergent) std::cout << BRED << divergent << " rounds diverged, first at round " << first_divergent << RESET << "\n";
+    else std::cout << "All round digests match.\n";
+    return divergent ? 2 : 0;
+}
+
+// -----------------------------
+// Table server: many tables in one process behind a Unix-domain socket (or ":PORT" for localhost
+// TCP). A client sends "JOIN <name>" and is seated at a free table; after that every line it sends
+// is what the seat would have typed at the terminal, and the table's text comes back unchanged.
+// One I/O thread owns the sockets. Rounds are coroutines that suspend whenever they need the seat's
+// input, so a small pool of workers resumes whichever tables have input waiting and never blocks.
+// -----------------------------
+struct ServerOptions {
+    std::string address;            // socket path, or ":PORT" for 127.0.0.1
+    int tables = 64;
+    int workers = 0;                // 0 = one per hardware thread
+    int turn_timeout_secs = 60;     // a seat that doesn't answer in time stands
+    bool audit = false;
+    std::uint64_t seed = 0;         // non-zero: table t seeds with seed + t
+};
+
+// A table's output, collected until the I/O thread picks it up
+class LineOutbox : public std::streambuf {
+private:
+    std::mutex m;
+    std::string pending;
+
+protected:
+    int_type overflow(int_type c) override {
+        if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+        std::lock_guard<std::mutex> lock(m);
+        pending.push_back(traits_type::to_char_type(c));
+        return c;
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        std::lock_guard<std::mutex> lock(m);
+        pending.append(s, static_cast<std::size_t>(n));
+        return n;
+    }
+
+public:
+    std::string take() {
+        std::lock_guard<std::mutex> lock(m);
+        std::string s;
+        s.swap(pending);
+        return s;
+    }
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+static volatile std::sig_atomic_t g_server_stop = 0;
+static void request_server_stop(int) { g_server_stop = 1; }
+
+static bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// "path" is a Unix-domain socket, ":PORT" is TCP on 127.0.0.1
+static socklen_t socket_address(const std::string& address, sockaddr_storage& storage) {
+    std::memset(&storage, 0, sizeof storage);
+    if (!address.empty() && address[0] == ':') {
+        auto *in = reinterpret_cast<sockaddr_in*>(&storage);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(static_cast<std::uint16_t>(std::stoi(address.substr(1))));
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return sizeof *in;
+    }
+    auto *un = reinterpret_cast<sockaddr_un*>(&storage);
+    if (address.size() >= sizeof un->sun_path) throw std::runtime_error("socket path too long: " + address);
+    un->sun_family = AF_UNIX;
+    std::memcpy(un->sun_path, address.c_str(), address.size() + 1);
+    return sizeof *un;
+}
+
+// Thousands of connections need more descriptors than the usual soft limit of 1024
+static void raise_fd_limit() {
+    rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+}
+
+class TableServer {
+private:
+    struct Table {
+        std::unique_ptr<BlackjackGame> game;   // null while the table is free
+        LineOutbox outbox;
+        std::string player;
+        std::int64_t round = 0;
+        int conn = -1;                          // the seated client's fd; I/O thread only
+        bool timed_out = false;                 // worker only: the rest of this round's requests go unanswered
+        // Actions posted to the game's turn_queue and not yet taken. Whoever raises it from 0
+        // hands the table to a worker, which keeps it until its decrement brings it back to 0.
+        std::atomic<int> pending{0};
+        std::atomic<bool> connected{false};
+        std::atomic<bool> finished{false};      // game over or the seat left: the I/O thread closes the client
+        std::atomic<std::int64_t> deadline{0};  // steady-clock ns when the awaited input times out, 0 if none
+    };
+    struct Conn {
+        std::string in, out;
+        int table = -1;
+        bool closing = false;       // drop once out has been sent
+    };
+    static constexpr std::size_t kMaxLine = 4096;
+
+    ServerOptions opt;
+    SharedProfiles profiles;
+    std::vector<std::unique_ptr<Table>> tables;
+    std::map<int, Conn> conns;      // I/O thread only
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<int> ready;          // tables handed to the workers
+    bool stopping = false;
+    std::vector<std::thread> workers;
+    int listen_fd = -1;
+    int wake_fds[2] = {-1, -1};
+
+    void wake() { char c = 0; if (::write(wake_fds[1], &c, 1) < 0) {} }
+
+    int open_listener() {
+        sockaddr_storage addr;
+        socklen_t len = socket_address(opt.address, addr);
+        int fd = ::socket(addr.ss_family, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (addr.ss_family == AF_INET) { int on = 1; setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on); }
+        else ::unlink(opt.address.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), len) < 0 || ::listen(fd, SOMAXCONN) < 0 || !set_nonblocking(fd)) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    static std::int64_t steady_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void hand_to_worker(int idx) {
+        { std::lock_guard<std::mutex> lock(m); ready.push_back(idx); }
+        cv.notify_one();
+    }
+
+    // Counts the action before pushing it, so a worker draining the table never takes more than
+    // pending and sweep() can't see 0 while a pass is still queued
+    void post(int idx, SeatAction action) {
+        Table &t = *tables[idx];
+        bool idle = t.pending.fetch_add(1, std::memory_order_acq_rel) == 0;
+        t.game->post_action(std::move(action));
+        if (idle) hand_to_worker(idx);
+    }
+
+    static void reply_error(Conn& c, bool bot, const std::string& message) {
+        if (!bot) { c.out += "ERR " + message + "\n"; return; }
+        std::ostringstream os;
+        JsonLine("error").str("message", message).send(os.rdbuf());
+        c.out += os.str();
+    }
+
+    // Seats a client at the first free table, with a fresh game checked out of the shared store.
+    // Bot clients get the JSON-lines protocol instead of the table text.
+    void join(int fd, Conn& c, const std::string& name, bool bot) {
+        if (name.empty() || name.size() > 32 || name.find('#') != std::string::npos) {
+            reply_error(c, bot, "names are 1-32 characters without '#'");
+            return;
+        }
+        if (!profiles.claim(name)) { reply_error(c, bot, name + " is already seated"); return; }
+        int idx = -1;
+        for (int i = 0; i < (int)tables.size() && idx < 0; ++i) if (!tables[i]->game) idx = i;
+        if (idx < 0) {
+            profiles.release(name);
+            reply_error(c, bot, "all tables are busy");
+            c.closing = true;
+            return;
+        }
+        Table &t = *tables[idx];
+        TableConfig cfg;
+        cfg.starting_chips = 200;
+        cfg.bet = 20;
+        cfg.persist = false;
+        cfg.paced = false;
+        cfg.remote = true;
+        cfg.human_name = name;
+        cfg.npc_tag = " #" + std::to_string(idx + 1);
+        if (opt.seed) cfg.seed = opt.seed + static_cast<std::uint64_t>(idx);
+        t.game.reset(new BlackjackGame(cfg));
+        t.game->set_audit(opt.audit);
+        t.game->apply_shoe(cfg.decks);
+        if (bot) t.game->set_bot_output(&t.outbox);
+        else t.game->set_output(&t.outbox);
+        t.game->set_shared_profiles(&profiles);
+        t.player = name;
+        t.round = 0;
+        t.timed_out = false;
+        t.conn = fd;
+        t.connected.store(true);
+        c.table = idx;
+        if (bot) {
+            JsonLine("seated").num("table", idx + 1).str("name", name).send(&t.outbox);
+            t.game->bot_deal(1);
+        } else c.out += "OK table " + std::to_string(idx + 1) + "\nSend (d)eal to start a round or (q) to leave: ";
+    }
+
+    void on_line(int fd, Conn& c, std::string line) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (c.closing) return;
+        if (c.table < 0) {
+            if (line.compare(0, 5, "JOIN ") == 0) join(fd, c, line.substr(5), false);
+            else if (line.compare(0, 4, "BOT ") == 0) join(fd, c, line.substr(4), true);
+            else if (line == "QUIT") c.closing = true;
+            else c.out += "ERR send JOIN <name> first\n";
+            return;
+        }
+        post(c.table, std::move(line));
+    }
+
+    void drop(int fd) {
+        auto it = conns.find(fd);
+        if (it == conns.end()) return;
+        if (it->second.table >= 0) {
+            Table &t = *tables[it->second.table];
+            t.conn = -1;
+            t.connected.store(false);
+        }
+        ::close(fd);
+        conns.erase(it);
+    }
+
+    // Reads what the client sent; false when it has gone
+    bool read_client(int fd, Conn& c) {
+        char buf[4096];
+        while (true) {
+            ssize_t n = ::read(fd, buf, sizeof buf);
+            if (n == 0) return false;
+            if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            c.in.append(buf, static_cast<std::size_t>(n));
+            std::size_t start = 0, nl;
+            while ((nl = c.in.find('\n', start)) != std::string::npos) {
+                on_line(fd, c, c.in.substr(start, nl - start));
+                start = nl + 1;
+            }
+            c.in.erase(0, start);
+            if (c.in.size() > kMaxLine) return false;
+        }
+    }
+
+    bool write_client(int fd, Conn& c) {
+        while (!c.out.empty()) {
+            ssize_t n = ::send(fd, c.out.data(), c.out.size(), 0);
+            if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            c.out.erase(0, static_cast<std::size_t>(n));
+        }
+        return true;
+    }
+
+    // Moves table output onto its client, times out seats that are taking too long, and frees
+    // tables whose session is over (a round abandoned mid-way is simply destroyed)
+    void sweep() {
+        std::int64_t now = steady_ns();
+        for (int idx = 0; idx < (int)tables.size(); ++idx) {
+            Table &t = *tables[idx];
+            if (!t.game) continue;
+            auto it = t.conn >= 0 ? conns.find(t.conn) : conns.end();
+            if (it != conns.end()) it->second.out += t.outbox.take();
+            if (t.pending.load(std::memory_order_acquire) != 0) continue;   // a worker has it
+            if (!t.finished.load() && t.connected.load()) {
+                std::int64_t due = t.deadline.load();
+                if (due && now >= due) { t.deadline.store(0); post(idx, std::nullopt); }
+                continue;
+            }
+            if (it != conns.end()) { it->second.table = -1; it->second.closing = true; }
+            profiles.release(t.player);
+            t.game.reset();
+            t.outbox.take();
+            t.conn = -1;
+            t.connected.store(false);
+            t.finished.store(false);
+            t.deadline.store(0);
+        }
+    }
+
+    // Runs the table as far as the seat's posted actions take it, counting the ones it takes;
+    // true when the session is over
+    bool advance(Table& t, int& taken) {
+        BlackjackGame &game = *t.game;
+        SeatAction action;
+        while (true) {
+            if (game.awaiting_input()) {
+                if (game.next_action(action)) {
+                    ++taken;
+                    if (!action) t.timed_out = true;
+                } else if (t.timed_out) action.reset();
+                else {
+                    t.deadline.store(steady_ns() + std::int64_t(std::max(1, opt.turn_timeout_secs)) * 1000000000);
+                    return false;
+                }
+                game.provide_input(std::move(action));
+            } else if (game.round_pending()) {
+                game.end_round();
+                if (!game.finish_round() || !game.human_seated() || game.leaving()) { game.end_game(); return true; }
+                if (game.bot_mode()) game.bot_deal(t.round + 1);
+                else std::ostream(&t.outbox) << "Send (d)eal for the next round or (q) to leave: ";
+            } else {
+                // Between rounds: any line deals, q leaves
+                if (!game.next_action(action)) return false;
+                ++taken;
+                if (!action) continue;   // a timeout that landed after its round had finished
+                t.timed_out = false;
+                if (!action->empty() && ((*action)[0] == 'q' || (*action)[0] == 'Q')) { game.end_game(); return true; }
+                game.begin_round(++t.round);
+            }
+        }
+    }
+
+    void worker_loop() {
+        while (true) {
+            int idx;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return stopping || !ready.empty(); });
+                if (ready.empty()) return;
+                idx = ready.front();
+                ready.pop_front();
+            }
+            Table &t = *tables[idx];
+            t.deadline.store(0);
+            int taken = 0;
+            if (t.connected.load() && !t.finished.load()) {
+                try { if (advance(t, taken)) t.finished.store(true); }
+                catch (const std::exception& ex) {
+                    std::cerr << "Table " << idx + 1 << ": " << ex.what() << "\n";
+                    t.finished.store(true);
+                }
+            }
+            if (t.finished.load() || !t.connected.load()) {
+                SeatAction stale;
+                while (t.game->next_action(stale)) ++taken;
+            }
+            // Past this decrement the table may be freed; anything still pending (possibly a push
+            // that isn't linked in yet) keeps it with this worker for another pass
+            bool more = t.pending.fetch_sub(taken, std::memory_order_acq_rel) != taken;
+            wake();
+            if (more) hand_to_worker(idx);
+        }
+    }
+
+public:
+    explicit TableServer(const ServerOptions& o) : opt(o), profiles("player_stats.db") {
+        for (int i = 0; i < std::max(1, opt.tables); ++i) tables.emplace_back(new Table);
+    }
+
+    int run() {
+        if (::pipe(wake_fds) < 0 || !set_nonblocking(wake_fds[0]) || !set_nonblocking(wake_fds[1])) {
+            std::cerr << "Cannot create wake pipe\n";
+            return 1;
+        }
+        raise_fd_limit();
+        listen_fd = open_listener();
+        if (listen_fd < 0) { std::cerr << "Cannot listen on " << opt.address << ": " << std::strerror(errno) << "\n"; return 1; }
+        std::signal(SIGPIPE, SIG_IGN);
+        std::signal(SIGINT, request_server_stop);
+        std::signal(SIGTERM, request_server_stop);
+
+        int nworkers = opt.workers > 0 ? opt.workers : std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < nworkers; ++i) workers.emplace_back([this] { worker_loop(); });
+        std::cout << "Serving " << tables.size() << " tables with " << nworkers << " workers on " << opt.address << "\n";
+
+        auto last_save = std::chrono::steady_clock::now();
+        std::vector<pollfd> fds;
+        while (!g_server_stop) {
+            fds.clear();
+            fds.push_back({listen_fd, POLLIN, 0});
+            fds.push_back({wake_fds[0], POLLIN, 0});
+            for (auto &kv : conns) fds.push_back({kv.first, static_cast<short>(POLLIN | (kv.second.out.empty() ? 0 : POLLOUT)), 0});
+            if (::poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) break;
+
+            if (fds[1].revents & POLLIN) { char buf[256]; while (::read(wake_fds[0], buf, sizeof buf) > 0) {} }
+            if (fds[0].revents & POLLIN) {
+                int fd;
+                while ((fd = ::accept(listen_fd, nullptr, nullptr)) >= 0) {
+                    if (!set_nonblocking(fd)) { ::close(fd); continue; }
+                    conns[fd].out = "BLACKJACK 1\nSend JOIN <name> to take a seat, or BOT <name> for the JSON-lines protocol\n";
+                }
+            }
+            std::vector<int> gone;
+            for (std::size_t i = 2; i < fds.size(); ++i) {
+                if (!fds[i].revents) continue;
+                Conn &c = conns[fds[i].fd];
+                if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !read_client(fds[i].fd, c)) gone.push_back(fds[i].fd);
+            }
+            for (int fd : gone) drop(fd);
+            sweep();
+            gone.clear();
+            for (auto &kv : conns) {
+                if (!write_client(kv.first, kv.second) || (kv.second.closing && kv.second.out.empty())) gone.push_back(kv.first);
+            }
+            for (int fd : gone) drop(fd);
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_save >= std::chrono::seconds(10)) { profiles.save(); last_save = now; }
+        }
+
+        std::cout << "\nShutting down...\n";
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto &w : workers) w.join();
+        while (!conns.empty()) drop(conns.begin()->first);
+        profiles.save();
+        ::close(listen_fd);
+        ::close(wake_fds[0]);
+        ::close(wake_fds[1]);
+        if (opt.address[0] != ':') ::unlink(opt.address.c_str());
+        return 0;
+    }
+};
+
+static int run_server(const ServerOptions& opt) {
+    TableServer server(opt);
+    return server.run();
+}
+#else
+static int run_server(const ServerOptions&) {
+    std::cerr << "The table server needs POSIX sockets, which this platform doesn't provide.\n";
+    return 1;
+}
+#endif
+
+// -----------------------------
+// Load generator: many bot clients on one poll() loop against a running table server. Each
+// client speaks the BOT protocol, plays a fixed policy with an optional think time before every
+// reply, and starts a new session (under a new name) when its seat goes bust.
+// -----------------------------
+enum class BotPolicy { Stand, Hit17, Random };
+
+struct LoadOptions {
+    std::string address;
+    int clients = 100;
+    long long rounds = 100;         // per client; 0 = until --duration runs out
+    int duration_secs = 0;          // 0 = no time limit
+    int think_ms = 0;               // mean pause before each reply, drawn from [0.5, 1.5] x mean
+    BotPolicy policy = BotPolicy::Hit17;
+    std::uint64_t seed = 0;
+};
+
+static BotPolicy parse_bot_policy(const std::string& name) {
+    if (name == "stand") return BotPolicy::Stand;
+    if (name == "hit17") return BotPolicy::Hit17;
+    if (name == "random") return BotPolicy::Random;
+    throw std::runtime_error("unknown policy '" + name + "' (stand, hit17 or random)");
+}
+
+// The value of "key":... in a protocol line, without a JSON parser; the first occurrence wins
+static std::string_view json_field(std::string_view line, std::string_view key) {
+    std::size_t k = 0;
+    while ((k = line.find(key, k)) != std::string_view::npos) {
+        std::size_t colon = k + key.size();
+        if (k > 0 && line[k - 1] == '"' && colon + 1 < line.size() && line[colon] == '"' && line[colon + 1] == ':') {
+            std::size_t v = colon + 2, end = v;
+            if (v < line.size() && line[v] == '"') { ++v; end = line.find('"', v); }
+            else while (end < line.size() && line[end] != ',' && line[end] != '}') ++end;
+            if (end == std::string_view::npos) end = line.size();
+            return line.substr(v, end - v);
+        }
+        k = colon;
+    }
+    return {};
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+class LoadGenerator {
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Client {
+        int fd = -1;
+        int session = 0;
+        long long rounds = 0;
+        std::string in, out;
+        std::string reply;              // held back until the think time has passed
+        Clock::time_point due;          // when reply (or a reconnect) is due; time_point() = nothing pending
+        Clock::time_point sent;         // when the last reply went out
+        Clock::time_point round_start;
+        Clock::duration round_think{};  // think time inside the current round, left out of its latency
+        bool reconnect = false;
+        bool done = false;
+    };
+    static constexpr auto kStall = std::chrono::seconds(30);
+
+    LoadOptions opt;
+    std::vector<Client> clients;
+    std::priority_queue<std::pair<Clock::time_point,int>, std::vector<std::pair<Clock::time_point,int>>, std::greater<>> timers;
+    std::mt19937_64 rng;
+    Clock::time_point start, stop_at;
+    int active = 0;
+
+    // Results
+    long long total_rounds = 0, decisions = 0, sessions = 0;
+    std::vector<double> round_ms, response_ms;
+    long long connect_errors = 0, server_errors = 0, disconnects = 0, stalls = 0;
+
+    bool time_up(Clock::time_point now) const { return opt.duration_secs > 0 && now >= stop_at; }
+    bool wants_more(const Client& c, Clock::time_point now) const {
+        return !time_up(now) && (opt.rounds <= 0 || c.rounds < opt.rounds);
+    }
+
+    void finish(Client& c) {
+        if (c.fd >= 0) ::close(c.fd);
+        c.fd = -1;
+        if (!c.done) { c.done = true; --active; }
+    }
+
+    void connect_client(int id) {
+        Client &c = clients[id];
+        sockaddr_storage addr;
+        socklen_t len = socket_address(opt.address, addr);
+        int fd = ::socket(addr.ss_family, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), len) < 0 || !set_nonblocking(fd)) {
+            if (fd >= 0) ::close(fd);
+            ++connect_errors;
+            finish(c);
+            return;
+        }
+        c.fd = fd;
+        c.in.clear();
+        c.out = "BOT load" + std::to_string(id) + "s" + std::to_string(c.session++) + "\n";
+        c.sent = Clock::now();
+        ++sessions;
+    }
+
+    void respond(int id, const char* reply, Clock::time_point now) {
+        Client &c = clients[id];
+        if (opt.think_ms <= 0) { c.out += reply; c.out += '\n'; c.sent = now; return; }
+        std::uniform_real_distribution<double> think(0.5 * opt.think_ms, 1.5 * opt.think_ms);
+        auto pause = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(think(rng)));
+        c.reply = reply;
+        c.due = now + pause;
+        c.round_think += pause;
+        timers.push({c.due, id});
+    }
+
+    const char* decide(int value) {
+        switch (opt.policy) {
+            case BotPolicy::Stand: return "s";
+            case BotPolicy::Hit17: return value < 17 ? "h" : "s";
+            case BotPolicy::Random: return value < 21 && (rng() & 1) ? "h" : "s";
+        }
+        return "s";
+    }
+
+    void on_message(int id, std::string_view line, Clock::time_point now) {
+        Client &c = clients[id];
+        if (line.empty() || line[0] != '{') return;   // the server's text greeting
+        response_ms.push_back(std::chrono::duration<double, std::milli>(now - c.sent).count());
+        std::string_view type = json_field(line, "type");
+        if (type == "deal") {
+            if (!wants_more(c, now)) { respond(id, "q", now); return; }
+            c.round_start = now;
+            c.round_think = Clock::duration::zero();
+            respond(id, "d", now);
+        } else if (type == "bet") respond(id, "", now);
+        else if (type == "turn") {
+            std::string_view v = json_field(line, "value");
+            int value = 0;
+            std::from_chars(v.data(), v.data() + v.size(), value);
+            ++decisions;
+            respond(id, decide(value), now);
+        } else if (type == "result") {
+            ++c.rounds;
+            ++total_rounds;
+            round_ms.push_back(std::chrono::duration<double, std::milli>(now - c.round_start - c.round_think).count());
+        } else if (type == "over") {
+            ::close(c.fd);
+            c.fd = -1;
+            if (wants_more(c, now)) connect_client(id);
+            else finish(c);
+        } else if (type == "error") {
+            ++server_errors;
+            if (json_field(line, "message") == "all tables are busy") finish(c);
+        }
+    }
+
+    // False when the connection has gone
+    bool read_client(int id, Clock::time_point now) {
+        Client &c = clients[id];
+        char buf[8192];
+        while (c.fd >= 0) {
+            ssize_t n = ::read(c.fd, buf, sizeof buf);
+            if (n == 0) return false;
+            if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            c.in.append(buf, static_cast<std::size_t>(n));
+            std::size_t begin = 0, nl;
+            while (c.fd >= 0 && (nl = c.in.find('\n', begin)) != std::string::npos) {
+                on_message(id, std::string_view(c.in).substr(begin, nl - begin), now);
+                begin = nl + 1;
+            }
+            if (c.fd < 0) return true;   // the session ended inside on_message
+            c.in.erase(0, begin);
+        }
+        return true;
+    }
+
+    bool write_client(Client& c) {
+        while (!c.out.empty()) {
+            ssize_t n = ::send(c.fd, c.out.data(), c.out.size(), 0);
+            if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            c.out.erase(0, static_cast<std::size_t>(n));
+        }
+        return true;
+    }
+
+    static void print_percentiles(const char* label, std::vector<double>& ms) {
+        std::cout << "  " << std::left << std::setw(18) << label << std::right;
+        if (ms.empty()) { std::cout << "(no samples)\n"; return; }
+        std::sort(ms.begin(), ms.end());
+        auto at = [&](double q) { return ms[std::min(ms.size() - 1, static_cast<std::size_t>(q * ms.size()))]; };
+        std::cout << std::fixed << std::setprecision(2)
+                  << "p50 " << at(0.50) << "  p90 " << at(0.90) << "  p99 " << at(0.99)
+                  << "  p99.9 " << at(0.999) << "  max " << ms.back() << " ms\n" << std::defaultfloat;
+    }
+
+public:
+    explicit LoadGenerator(const LoadOptions& o) : opt(o), clients(std::max(1, o.clients)) {
+        rng.seed(opt.seed ? opt.seed : std::random_device{}());
+    }
+
+    int run() {
+        raise_fd_limit();
+        std::signal(SIGPIPE, SIG_IGN);
+        start = Clock::now();
+        stop_at = start + std::chrono::seconds(opt.duration_secs);
+        active = (int)clients.size();
+        for (int i = 0; i < (int)clients.size(); ++i) connect_client(i);
+
+        std::vector<pollfd> fds;
+        std::vector<int> ids;
+        while (active > 0) {
+            auto now = Clock::now();
+            while (!timers.empty() && timers.top().first <= now) {
+                auto [due, id] = timers.top();
+                timers.pop();
+                Client &c = clients[id];
+                if (c.done || c.fd < 0 || c.due != due) continue;
+                c.out += c.reply;
+                c.out += '\n';
+                c.sent = now;
+                c.due = Clock::time_point();
+            }
+            fds.clear();
+            ids.clear();
+            for (int i = 0; i < (int)clients.size(); ++i) {
+                Client &c = clients[i];
+                if (c.fd < 0) continue;
+                if (c.due == Clock::time_point() && now - c.sent > kStall) { ++stalls; finish(c); continue; }
+                fds.push_back({c.fd, static_cast<short>(POLLIN | (c.out.empty() ? 0 : POLLOUT)), 0});
+                ids.push_back(i);
+            }
+            int timeout = 100;
+            if (!timers.empty()) {
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(timers.top().first - now).count();
+                timeout = static_cast<int>(std::max<long long>(0, std::min<long long>(timeout, wait + 1)));
+            }
+            if (::poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) break;
+            now = Clock::now();
+            for (std::size_t k = 0; k < fds.size(); ++k) {
+                Client &c = clients[ids[k]];
+                if (c.fd != fds[k].fd) continue;   // the session was replaced earlier in this pass
+                bool alive = true;
+                if (fds[k].revents & (POLLIN | POLLHUP | POLLERR)) alive = read_client(ids[k], now);
+                if (alive && c.fd >= 0 && c.fd == fds[k].fd) alive = write_client(c);
+                if (!alive) { ++disconnects; finish(c); }
+            }
+            for (auto &c : clients) if (c.fd >= 0 && !c.out.empty()) write_client(c);
+        }
+
+        double secs = std::chrono::duration<double>(Clock::now() - start).count();
+        static const char* policies[] = {"stand", "hit17", "random"};
+        std::cout << BOLD << "Load test against " << opt.address << RESET << ": " << clients.size() << " clients, policy "
+                  << policies[static_cast<int>(opt.policy)] << ", think " << opt.think_ms << " ms\n"
+                  << std::fixed << std::setprecision(2)
+                  << "  " << total_rounds << " rounds in " << secs << "s (" << total_rounds / std::max(secs, 1e-9) << " rounds/s), "
+                  << decisions << " decisions, " << sessions << " sessions\n" << std::defaultfloat;
+        print_percentiles("round latency", round_ms);
+        print_percentiles("response latency", response_ms);
+        long long errors = connect_errors + server_errors + disconnects + stalls;
+        std::cout << "  errors: " << errors << " (connect " << connect_errors << ", server " << server_errors
+                  << ", disconnect " << disconnects << ", stalled " << stalls << ")\n";
+        return errors ? 1 : 0;
+    }
+};
+static int run_loadgen(const LoadOptions& opt) {
+    LoadGenerator gen(opt);
+    return gen.run();
+}
+#else
+static int run_loadgen(const LoadOptions&) {
+    std::cerr << "The load generator needs POSIX sockets, which this platform doesn't provide.\n";
+    return 1;
+}
+#endif
+
 // -----------------------------
 // main
 // -----------------------------
-int main() {
+int main(int argc, char* argv[]) {
     try {
-        BlackjackGame game(200, 20, 1);
-        game.game_loop();
+        SimOptions sim;
+        bool simulate = false;
+        std::string query_path;
+        std::vector<std::string> query_predicates;
+        std::string replay_path;
+        std::int64_t replay_round = 0;
+        ServerOptions server;
+        LoadOptions load;
+        bool bot = false;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            if (arg == "--audit") sim.audit = true;
+            else if (arg == "--bot") bot = true;
+            else if (arg == "--query" && has_value) {
+                // Everything after the path is a predicate
+                query_path = argv[++i];
+                while (i + 1 < argc) query_predicates.push_back(argv[++i]);
+            }
+            else if (arg == "--simulate" && has_value) { simulate = true; sim.rounds = std::stoll(argv[++i]); }
+            else if (arg == "--threads" && has_value) sim.threads = std::stoi(argv[++i]);
+            else if (arg == "--histograms") sim.histograms = true;
+            else if (arg == "--precision" && has_value) {
+                sim.precision_pct = std::stod(argv[++i]);
+                if (!simulate) { simulate = true; sim.rounds = kPrecisionRoundCap; }
+            }
+            else if (arg == "--confidence" && has_value) sim.z = z_for_confidence(std::stoi(argv[++i]));
+            else if (arg == "--checkpoint" && has_value) sim.checkpoint = argv[++i];
+            else if (arg == "--checkpoint-every" && has_value) sim.checkpoint_secs = std::stoi(argv[++i]);
+            else if (arg == "--history" && has_value) sim.history = argv[++i];
+            else if (arg == "--events" && has_value) sim.events = argv[++i];
+            else if (arg == "--seed" && has_value) sim.seed = std::stoull(argv[++i]);
+            else if (arg == "--replay" && has_value) replay_path = argv[++i];
+            else if (arg == "--round" && has_value) replay_round = std::stoll(argv[++i]);
+            else if (arg == "--serve" && has_value) server.address = argv[++i];
+            else if (arg == "--tables" && has_value) server.tables = std::stoi(argv[++i]);
+            else if (arg == "--turn-timeout" && has_value) server.turn_timeout_secs = std::stoi(argv[++i]);
+            else if (arg == "--loadgen" && has_value) load.address = argv[++i];
+            else if (arg == "--clients" && has_value) load.clients = std::stoi(argv[++i]);
+            else if (arg == "--rounds" && has_value) load.rounds = std::stoll(argv[++i]);
+            else if (arg == "--duration" && has_value) load.duration_secs = std::stoi(argv[++i]);
+            else if (arg == "--think" && has_value) load.think_ms = std::stoi(argv[++i]);
+            else if (arg == "--policy" && has_value) load.policy = parse_bot_policy(argv[++i]);
+            else if (arg == "--resume" && has_value) { simulate = true; sim.resume = argv[++i]; }
+            else if (arg == "--seats" && has_value) sim.seats = std::max(1, std::min(kMaxSeats, std::stoi(argv[++i])));
+            else {
+                std::cerr << "Unknown option: " << arg << "\n"
+                          << "Usage: " << argv[0] << " [--audit] [--simulate ROUNDS] [--precision PCT [--confidence 90|95|99]]\n"
+                          << "       [--threads N] [--seats N] [--histograms] [--checkpoint FILE [--checkpoint-every SECS]]\n"
+                          << "       [--resume FILE] [--history DIR] [--events DIR] [--seed N]\n"
+                          << "           --precision stops at ROUNDS, or " << kPrecisionRoundCap << " rounds without --simulate\n"
+                          << "       " << argv[0] << " --replay EVENTLOG [--round N]\n"
+                          << "       " << argv[0] << " --bot [--audit] [--seed N] [--history DIR] [--events DIR]\n"
+                          << "       " << argv[0] << " --serve SOCKET|:PORT [--tables N] [--threads N] [--turn-timeout SECS] [--audit] [--seed N]\n"
+                          << "       " << argv[0] << " --loadgen SOCKET|:PORT [--clients N] [--rounds N] [--duration SECS] [--think MS]\n"
+                          << "                  [--policy stand|hit17|random] [--seed N]\n"
+                          << "       " << argv[0] << " [--threads N] --query DIR|FILE [column=value|column=lo..hi ...]\n";
+                return 1;
+            }
+        }
+        if (!query_path.empty()) return run_query(query_path, query_predicates, sim.threads);
+        if (!replay_path.empty()) return run_replay(replay_path, replay_round);
+        if (!load.address.empty()) {
+            load.seed = sim.seed;
+            return run_loadgen(load);
+        }
+        if (!server.address.empty()) {
+            server.workers = sim.threads;
+            server.audit = sim.audit;
+            server.seed = sim.seed;
+            return run_server(server);
+        }
+        if (!sim.history.empty()) std::filesystem::create_directories(sim.history);
+        if (!sim.events.empty()) std::filesystem::create_directories(sim.events);
+        if (simulate) return run_simulation(sim);
+        TableConfig table;
+        table.starting_chips = 200;
+        table.bet = 20;
+        table.seed = sim.seed;
+        if (bot) {
+            // Machine speed: no pacing, and no profile rewrite or ledger spill every round
+            std::ios::sync_with_stdio(false);
+            table.quiet = true;
+            table.persist = false;
+        }
+        BlackjackGame game(table);
+        game.set_audit(sim.audit);
+        std::unique_ptr<HandHistoryWriter> history;
+        if (!sim.history.empty()) { history.reset(new HandHistoryWriter(history_path(sim.history, 0))); game.set_history(history.get()); }
+        std::unique_ptr<EventLogWriter> events;
+        if (!sim.events.empty()) { events.reset(new EventLogWriter(events_path(sim.events, 0))); game.set_event_log(events.get()); }
+        if (bot) {
+            game.set_bot_output(std::cout.rdbuf());
+            game.apply_shoe(table.decks);
+            game.bot_loop();
+        } else game.game_loop();
         return 0;
     } catch (const std::exception &ex) {
         std::cerr << "Unhandled exception: " << ex.what() << "\n";
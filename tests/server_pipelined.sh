@@ -0,0 +1,66 @@
+#!/bin/sh
+# --serve under ThreadSanitizer: clients send a whole hand's input in one write, so actions
+# reach a table while its worker is still draining the previous ones.
+# usage: tests/server_pipelined.sh [path/to/blackjack]   (builds main.cpp with -fsanitize=thread
+# when no binary is given)
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+bin=${1:-}
+if [ -z "$bin" ]; then
+    bin="$work/blackjack"
+    g++ -std=c++20 -w -O1 -g -fsanitize=thread -pthread "$root/main.cpp" -o "$bin"
+fi
+cd "$work"
+TSAN_OPTIONS="halt_on_error=1 exitcode=66" "$bin" --serve "$work/bj.sock" --tables 8 --threads 4 --turn-timeout 1 --seed 5 \
+    < /dev/null > server.log 2>&1 &
+server=$!
+trap 'kill -9 $server 2> /dev/null || true; rm -rf "$work"' EXIT
+for i in $(seq 50); do [ -S bj.sock ] && break; sleep 0.2; done
+
+# Each client plays a few sessions: JOIN, then deal, default bet, hit, stand and quit in a
+# single write; q is resent until the server closes the connection (a bust moves the stand
+# to the next round's deal, and a q there only sets the default bet)
+python3 - "$work/bj.sock" <<'PY'
+import socket, sys, threading, time
+errors = []
+def session(name):
+    s = socket.socket(socket.AF_UNIX)
+    s.connect(sys.argv[1])
+    s.settimeout(0.5)
+    buf = b""
+    s.sendall(b"JOIN " + name.encode() + b"\n")
+    deadline = time.time() + 5
+    while b"(q) to leave" not in buf:
+        if time.time() > deadline: raise RuntimeError(name + ": not seated: " + repr(buf[-200:]))
+        try: buf += s.recv(65536)
+        except socket.timeout: pass
+    s.sendall(b"d\n\nh\ns\nq\n")
+    deadline = time.time() + 30
+    while True:
+        if time.time() > deadline: raise RuntimeError(name + ": table never closed")
+        try:
+            if not s.recv(65536): break
+        except socket.timeout:
+            try: s.sendall(b"q\n")
+            except OSError: break
+        except OSError: break
+    s.close()
+def client(k):
+    try:
+        for n in range(4): session("P%d_%d" % (k, n))
+    except Exception as ex: errors.append(str(ex))
+threads = [threading.Thread(target=client, args=(k,)) for k in range(8)]
+for t in threads: t.start()
+for t in threads: t.join()
+if errors: sys.exit("\n".join(errors))
+PY
+[ $? -eq 0 ] || { echo "FAIL: clients"; cat server.log; exit 1; }
+kill -0 "$server" 2> /dev/null || { echo "FAIL: server died"; cat server.log; exit 1; }
+kill -INT "$server"
+status=0
+wait "$server" || status=$?
+if [ "$status" -ne 0 ] || grep -q "ThreadSanitizer" server.log; then
+    echo "FAIL: server exit status $status"; cat server.log; exit 1
+fi
+echo "PASS: pipelined input across 8 tables"
@@ -0,0 +1,53 @@
+#!/bin/sh
+# --serve: a text client that quits mid-hand leaves its table; the server keeps running,
+# seats the next client and still saves profiles on SIGINT.
+# usage: tests/server_quit.sh [path/to/blackjack]   (builds main.cpp when no binary is given)
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+bin=${1:-}
+if [ -z "$bin" ]; then
+    bin="$work/blackjack"
+    g++ -std=c++20 -w -O2 -pthread "$root/main.cpp" -o "$bin"
+fi
+cd "$work"
+"$bin" --serve "$work/bj.sock" --tables 2 --seed 11 < /dev/null > server.log 2>&1 &
+server=$!
+trap 'kill -9 $server 2> /dev/null || true; rm -rf "$work"' EXIT
+for i in 1 2 3 4 5 6 7 8 9 10; do [ -S bj.sock ] && break; sleep 0.2; done
+
+# JOIN, deal, take the default bet, then q at the first action prompt
+client() {
+    python3 - "$work/bj.sock" "$1" <<'PY'
+import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+s.settimeout(5)
+buf = b""
+def expect(token):
+    global buf
+    while token not in buf:
+        data = s.recv(65536)
+        if not data: sys.exit("connection closed waiting for %r" % token)
+        buf += data
+    buf = buf.split(token, 1)[1]
+s.sendall(b"JOIN " + sys.argv[2].encode() + b"\n")
+expect(b"(q) to leave")
+s.sendall(b"d\n")
+expect(b"type an amount")
+s.sendall(b"\n")
+expect(b"Choose action")
+s.sendall(b"q\n")
+expect(b"will leave after this round")
+s.close()
+PY
+}
+
+client Alice || { echo "FAIL: first client"; cat server.log; exit 1; }
+sleep 0.3
+kill -0 "$server" 2> /dev/null || { echo "FAIL: server exited when a client quit"; cat server.log; exit 1; }
+client Bob || { echo "FAIL: server did not seat a second client"; cat server.log; exit 1; }
+kill -INT "$server"
+wait "$server" || { echo "FAIL: server exit status $?"; cat server.log; exit 1; }
+[ -s player_stats.db ] || { echo "FAIL: no player_stats.db after shutdown"; cat server.log; exit 1; }
+echo "PASS: remote quit leaves the server running"